@@ -14,6 +14,6 @@ public class FlowPathPlugin : ModuleRules
 		PrivateIncludePaths.AddRange(new string[] {"FlowPathPlugin/Private"});
 			
 		PublicDependencyModuleNames.AddRange(new string[] {"Core"});
-        PrivateDependencyModuleNames.AddRange(new string[] {"CoreUObject", "Engine"});
+        PrivateDependencyModuleNames.AddRange(new string[] {"CoreUObject", "Engine", "Json"});
 	}
 }
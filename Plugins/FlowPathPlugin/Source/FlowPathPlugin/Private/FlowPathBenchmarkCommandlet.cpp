@@ -0,0 +1,255 @@
+// Created by Michael Galetzka - all rights reserved.
+
+#include "FlowPathBenchmarkCommandlet.h"
+#include "flow/FlowPath.h"
+#include "flow/EikonalSolver.h"
+#include "flow/MapGenerator.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/App.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+
+using namespace flow;
+
+// the number of different targets in the portal searches, the cached searches merge with the previous searches to the same target
+static const int32 BenchmarkTargetCount = 8;
+
+UFlowPathBenchmarkCommandlet::UFlowPathBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsEditor = false;
+    IsServer = false;
+    LogToConsole = true;
+}
+
+static TArray<TilePoint> findOpenCells(const TArray<uint8>& map, int32 width, int32 tileLength, int32 count, FRandomStream& random)
+{
+    TArray<TilePoint> result;
+    int32 attempts = count * 100;
+    while (result.Num() < count && attempts-- > 0) {
+        int32 index = random.RandRange(0, map.Num() - 1);
+        if (map[index] == BLOCKED) {
+            continue;
+        }
+        FIntPoint cell(index % width, index / width);
+        result.Add({ FIntPoint(cell.X / tileLength, cell.Y / tileLength), FIntPoint(cell.X % tileLength, cell.Y % tileLength) });
+    }
+    return result;
+}
+
+static TArray<FIntPoint> getWindowCells(const Portal& portal)
+{
+    TArray<FIntPoint> cells;
+    for (int32 y = portal.start.Y; y <= portal.end.Y; y++) {
+        for (int32 x = portal.start.X; x <= portal.end.X; x++) {
+            cells.Emplace(x, y);
+        }
+    }
+    return cells;
+}
+
+int32 UFlowPathBenchmarkCommandlet::Main(const FString& Params)
+{
+    FString tileLengthsParam = TEXT("10,20,50");
+    FParse::Value(*Params, TEXT("TileLengths="), tileLengthsParam);
+    sampleCount = 200;
+    FParse::Value(*Params, TEXT("Samples="), sampleCount);
+    mapTiles = 8;
+    FParse::Value(*Params, TEXT("MapTiles="), mapTiles);
+    seed = 1;
+    FParse::Value(*Params, TEXT("Seed="), seed);
+    FString outputFile = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FlowPathBenchmark.json"));
+    FParse::Value(*Params, TEXT("Output="), outputFile);
+
+    TArray<FString> tileLengthStrings;
+    tileLengthsParam.ParseIntoArray(tileLengthStrings, TEXT(","));
+    if (tileLengthStrings.Num() == 0 || sampleCount <= 0 || mapTiles < 2) {
+        UE_LOG(LogExec, Error, TEXT("Invalid benchmark parameters"));
+        return 1;
+    }
+
+    results.Empty();
+    for (auto& tileLengthString : tileLengthStrings) {
+        int32 tileLength = FCString::Atoi(*tileLengthString);
+        if (tileLength < 4) {
+            UE_LOG(LogExec, Error, TEXT("Invalid tile length %s"), *tileLengthString);
+            return 1;
+        }
+        for (auto mapType : allMapTypes) {
+            runMapBenchmarks(static_cast<uint8>(mapType), tileLength);
+        }
+    }
+
+    auto root = MakeShared<FJsonObject>();
+    root->SetNumberField(TEXT("formatVersion"), 1);
+    root->SetStringField(TEXT("platform"), FPlatformProperties::IniPlatformName());
+    root->SetStringField(TEXT("buildConfiguration"), EBuildConfigurations::ToString(FApp::GetBuildConfiguration()));
+    root->SetNumberField(TEXT("samples"), sampleCount);
+    root->SetNumberField(TEXT("mapTiles"), mapTiles);
+    root->SetNumberField(TEXT("seed"), seed);
+    root->SetArrayField(TEXT("results"), results);
+
+    FString json;
+    auto writer = TJsonWriterFactory<>::Create(&json);
+    if (!FJsonSerializer::Serialize(root, writer) || !FFileHelper::SaveStringToFile(json, *outputFile)) {
+        UE_LOG(LogExec, Error, TEXT("Unable to write the benchmark results to %s"), *outputFile);
+        return 1;
+    }
+    UE_LOG(LogExec, Display, TEXT("Wrote %d benchmark results to %s"), results.Num(), *outputFile);
+    return 0;
+}
+
+void UFlowPathBenchmarkCommandlet::addResult(const TCHAR* benchmark, const TCHAR* mapName, int32 tileLength, TArray<double>& sampleMicros, int32 successCount)
+{
+    if (sampleMicros.Num() == 0) {
+        return;
+    }
+    sampleMicros.Sort();
+    double total = 0;
+    for (double sample : sampleMicros) {
+        total += sample;
+    }
+    auto percentile = [&sampleMicros](float p) {
+        return sampleMicros[FMath::Min(FMath::FloorToInt(p * sampleMicros.Num()), sampleMicros.Num() - 1)];
+    };
+
+    auto result = MakeShared<FJsonObject>();
+    result->SetStringField(TEXT("benchmark"), benchmark);
+    result->SetStringField(TEXT("map"), mapName);
+    result->SetNumberField(TEXT("tileLength"), tileLength);
+    result->SetNumberField(TEXT("samples"), sampleMicros.Num());
+    result->SetNumberField(TEXT("successes"), successCount);
+    result->SetNumberField(TEXT("totalMs"), total / 1000);
+    result->SetNumberField(TEXT("meanUs"), total / sampleMicros.Num());
+    result->SetNumberField(TEXT("minUs"), sampleMicros[0]);
+    result->SetNumberField(TEXT("medianUs"), percentile(0.5f));
+    result->SetNumberField(TEXT("p95Us"), percentile(0.95f));
+    result->SetNumberField(TEXT("maxUs"), sampleMicros.Last());
+    results.Add(MakeShared<FJsonValueObject>(result));
+
+    UE_LOG(LogExec, Display, TEXT("%-24s %-14s %4d: mean %10.2f us, median %10.2f us, p95 %10.2f us (%d/%d successful)"),
+        benchmark, mapName, tileLength, total / sampleMicros.Num(), percentile(0.5f), percentile(0.95f), successCount, sampleMicros.Num());
+}
+
+void UFlowPathBenchmarkCommandlet::runMapBenchmarks(uint8 mapTypeValue, int32 tileLength)
+{
+    MapType mapType = static_cast<MapType>(mapTypeValue);
+    const TCHAR* mapName = MapGenerator::getName(mapType);
+    int32 width = mapTiles * tileLength;
+    TArray<uint8> map = MapGenerator::generate(mapType, width, width, seed);
+    FRandomStream random(seed);
+
+    TArray<TArray<uint8>> tilesData;
+    TArray<FIntPoint> tileCoordinates;
+    for (int32 y = 0; y < mapTiles; y++) {
+        for (int32 x = 0; x < mapTiles; x++) {
+            tileCoordinates.Emplace(x, y);
+            tilesData.Add(MapGenerator::getTileData(map, width, FIntPoint(x, y), tileLength));
+        }
+    }
+
+    TArray<double> samples;
+    int32 successes = 0;
+    auto measure = [&samples, &successes](TFunctionRef<bool()> function) {
+        double start = FPlatformTime::Seconds();
+        bool success = function();
+        samples.Add((FPlatformTime::Seconds() - start) * 1000000);
+        successes += success ? 1 : 0;
+    };
+    auto report = [&](const TCHAR* benchmark) {
+        addResult(benchmark, mapName, tileLength, samples, successes);
+        samples.Reset();
+        successes = 0;
+    };
+
+    // tile construction, including the portal search and the connections inside the tile
+    TArray<TUniquePtr<FlowTile>> tiles;
+    for (int32 i = 0; i < sampleCount; i++) {
+        int32 tileIndex = i % tilesData.Num();
+        TUniquePtr<FlowTile> tile;
+        measure([&]() {
+            tile = MakeUnique<FlowTile>(tilesData[tileIndex], tileLength, tileCoordinates[tileIndex]);
+            return true;
+        });
+        // the tiles are only destroyed outside of the measurement
+        if (tiles.Num() < tilesData.Num()) {
+            tiles.Add(MoveTemp(tile));
+        }
+    }
+    report(TEXT("tileConstruction"));
+
+    // flowmap solves from a portal window over a single tile
+    TArray<TPair<int32, TArray<FIntPoint>>> solveTargets;
+    for (int32 i = 0; i < tiles.Num(); i++) {
+        for (auto& portal : tiles[i]->getPortals()) {
+            solveTargets.Emplace(i, getWindowCells(portal));
+        }
+    }
+    for (int32 i = 0; i < sampleCount && solveTargets.Num() > 0; i++) {
+        auto& solve = solveTargets[random.RandRange(0, solveTargets.Num() - 1)];
+        measure([&]() {
+            return CreateEikonalSurface(tilesData[solve.Key], solve.Value).Num() > 0;
+        });
+    }
+    report(TEXT("createEikonalSurface"));
+
+    // A* searches inside a single tile
+    for (int32 i = 0; i < sampleCount && tiles.Num() > 0; i++) {
+        int32 tileIndex = random.RandRange(0, tiles.Num() - 1);
+        FIntPoint start(random.RandRange(0, tileLength - 1), random.RandRange(0, tileLength - 1));
+        FIntPoint end(random.RandRange(0, tileLength - 1), random.RandRange(0, tileLength - 1));
+        auto& data = tilesData[tileIndex];
+        if (data[start.X + start.Y * tileLength] == BLOCKED || data[end.X + end.Y * tileLength] == BLOCKED) {
+            continue;
+        }
+        measure([&]() {
+            return tiles[tileIndex]->findPath(start, end).success;
+        });
+    }
+    report(TEXT("findPath"));
+
+    FlowPath flowPath(tileLength);
+    flowPath.beginBulkUpdate();
+    flowPath.replaceTilesData(tileCoordinates, tilesData);
+    flowPath.endBulkUpdate();
+
+    // portal searches, grouped by target so the cached run can merge with the previous searches
+    TArray<TilePoint> targets = findOpenCells(map, width, tileLength, BenchmarkTargetCount, random);
+    TArray<TilePoint> starts = findOpenCells(map, width, tileLength, sampleCount, random);
+    for (bool useCache : { false, true }) {
+        for (auto& target : targets) {
+            flowPath.deleteFromPathCache(target);
+        }
+        for (int32 i = 0; i < starts.Num() && targets.Num() > 0; i++) {
+            auto& target = targets[i * targets.Num() / starts.Num()];
+            measure([&]() {
+                return flowPath.findPortalPath(starts[i], target, useCache).success;
+            });
+        }
+        report(useCache ? TEXT("findPortalPathCached") : TEXT("findPortalPath"));
+    }
+
+    // lookahead solves over the 2x2 tile block between a portal and a portal in the diagonal tile
+    TArray<TPair<const Portal*, const Portal*>> lookaheadPairs;
+    const FIntPoint diagonals[] = { FIntPoint(1, 1), FIntPoint(1, -1), FIntPoint(-1, 1), FIntPoint(-1, -1) };
+    for (auto portal : flowPath.getAllPortals()) {
+        for (auto& delta : diagonals) {
+            for (auto lookaheadPortal : flowPath.getAllTilePortals(portal->tileCoordinates + delta)) {
+                lookaheadPairs.Emplace(portal, lookaheadPortal);
+            }
+        }
+    }
+    for (int32 i = 0; i < sampleCount && lookaheadPairs.Num() > 0; i++) {
+        auto& pair = lookaheadPairs[random.RandRange(0, lookaheadPairs.Num() - 1)];
+        measure([&]() {
+            TArray<FIntPoint> lookaheadTargets;
+            TArray<uint8> sourceData;
+            pair.Key->parentTile->calculateFlowmapTargets(pair.Key, pair.Value, lookaheadTargets);
+            flowPath.createFlowMapSourceData(pair.Key->tileCoordinates, pair.Value->tileCoordinates - pair.Key->tileCoordinates, sourceData);
+            return CreateEikonalSurface(sourceData, lookaheadTargets).Num() > 0;
+        });
+    }
+    report(TEXT("lookaheadSolve"));
+}
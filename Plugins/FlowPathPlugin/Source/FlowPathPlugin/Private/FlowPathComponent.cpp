@@ -9,6 +9,8 @@ UFlowPathComponent::UFlowPathComponent()
 
     bUpdateOnlyIfRendered = false;
     bTickBeforeOwner = true;
+    bUseAgentBuffers = true;
+    bIsSelected = false;
 
     bWantsInitializeComponent = true;
     bAutoActivate = true;
@@ -53,10 +55,52 @@ void UFlowPathComponent::TickComponent(float DeltaTime, ELevelTick TickType, FAc
     auto actorLocation = UpdatedPawn->GetActorLocation();
     agentInfo.agentLocation.X = actorLocation.X;
     agentInfo.agentLocation.Y = actorLocation.Y;
+    syncAgentBuffers();
 
     UpdatedPawn->AddMovementInput(FVector(acceleration.X, acceleration.Y, 0));
 }
 
+void UFlowPathComponent::syncAgentBuffers()
+{
+    if (agentHandle == INDEX_NONE || !IsValid(FlowPathManager)) {
+        return;
+    }
+    auto& buffers = FlowPathManager->GetAgentBuffers();
+
+    // read the results of the last manager tick, the events are forwarded so blueprint implementations still get notified
+    uint8 flags = buffers.flags[agentHandle];
+    uint32 eventSequence = buffers.eventSequences[agentHandle];
+    bool hasNewEvent = eventSequence != acknowledgedEventSequence;
+    acknowledgedEventSequence = eventSequence;
+    if (hasNewEvent && !bHasPendingMove) {
+        if (flags & AgentFlags::TargetReached) {
+            INavAgent::Execute_TargetReached(this);
+        }
+        else if (flags & AgentFlags::TargetUnreachable) {
+            INavAgent::Execute_TargetUnreachable(this);
+        }
+    }
+    else {
+        acceleration = buffers.accelerations[agentHandle];
+    }
+
+    // write the inputs for the next manager tick
+    buffers.positions[agentHandle] = agentInfo.agentLocation;
+    buffers.targets[agentHandle] = agentInfo.targetLocation;
+    buffers.groups[agentHandle] = agentInfo.groupID;
+    uint8 inputFlags = agentInfo.isPathfindingActive ? AgentFlags::PathfindingActive : 0;
+    if (IsValid(UpdatedPawn) && !UpdatedPawn->WasRecentlyRendered()) {
+        inputFlags |= AgentFlags::Unseen;
+    }
+    if (bIsSelected) {
+        inputFlags |= AgentFlags::Selected;
+    }
+    // the target event bits are owned by the manager
+    inputFlags |= flags & (AgentFlags::TargetReached | AgentFlags::TargetUnreachable);
+    buffers.flags[agentHandle] = inputFlags;
+    bHasPendingMove = false;
+}
+
 void UFlowPathComponent::RegisterComponentTickFunctions(bool bRegister)
 {
     Super::RegisterComponentTickFunctions(bRegister);
@@ -101,6 +145,13 @@ void UFlowPathComponent::InitializeComponent()
     }
 }
 
+void UFlowPathComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    unregisterFromManager();
+
+    Super::EndPlay(EndPlayReason);
+}
+
 void UFlowPathComponent::OnRegister()
 {
     Super::OnRegister();
@@ -170,19 +221,46 @@ void UFlowPathComponent::SetUpdatedPawn(APawn * NewUpdatedPawn)
 
 void UFlowPathComponent::SetFlowPathManager(AFlowPathManager * NewFlowPathManager)
 {
-    if (IsValid(FlowPathManager)) {
-        FlowPathManager->RemoveAgent(this);
-    }
+    unregisterFromManager();
 
     // Don't assign pending kill components, but allow those to null out previous UpdatedComponent.
     FlowPathManager = IsValid(NewFlowPathManager) ? NewFlowPathManager : NULL;
-    if (IsValid(FlowPathManager)) {
+    registerWithManager();
+}
+
+void UFlowPathComponent::registerWithManager()
+{
+    if (!IsValid(FlowPathManager)) {
+        return;
+    }
+    if (bUseAgentBuffers) {
+        agentHandle = FlowPathManager->CreateAgentHandle();
+        acknowledgedEventSequence = FlowPathManager->GetAgentBuffers().eventSequences[agentHandle];
+        syncAgentBuffers();
+    }
+    else {
         FlowPathManager->RegisterAgent(this);
     }
 }
 
+void UFlowPathComponent::unregisterFromManager()
+{
+    if (!IsValid(FlowPathManager)) {
+        agentHandle = INDEX_NONE;
+        return;
+    }
+    if (agentHandle != INDEX_NONE) {
+        FlowPathManager->ReleaseAgentHandle(agentHandle);
+        agentHandle = INDEX_NONE;
+    }
+    else {
+        FlowPathManager->RemoveAgent(this);
+    }
+}
+
 void UFlowPathComponent::MovePawnToTarget(FVector2D Target)
 {
     agentInfo.isPathfindingActive = true;
     agentInfo.targetLocation = Target;
+    bHasPendingMove = true;
 }
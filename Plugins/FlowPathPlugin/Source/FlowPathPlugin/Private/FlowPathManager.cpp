@@ -3,10 +3,112 @@
 #include "FlowPathManager.h"
 #include "DrawDebugHelpers.h"
 #include "flow/EikonalSolver.h"
+#include "flow/FlowMapDiskCache.h"
+#include "flow/FlowMapPool.h"
+#include "flow/Counters.h"
+#include "flow/ChromeTrace.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/Paths.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
 
 DECLARE_CYCLE_STAT(TEXT("FlowPath manager ~ tick"), STAT_ManagerTick, STATGROUP_FlowPath); 
 DECLARE_CYCLE_STAT(TEXT("FlowPath manager ~ update data from texture"), STAT_ManagerUpdateFromTexture, STATGROUP_FlowPath);
 DECLARE_CYCLE_STAT(TEXT("FlowPath manager ~ update dirty path data"), STAT_ManagerDirtyPaths, STATGROUP_FlowPath);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("FlowPath manager ~ queued flowmap tasks"), STAT_ManagerQueuedFlowmapTasks, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath manager ~ merged flowmap requests"), STAT_ManagerMergedFlowmapRequests, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath manager ~ dropped flowmap requests"), STAT_ManagerDroppedFlowmapRequests, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath manager ~ evicted flowmap tasks"), STAT_ManagerEvictedFlowmapTasks, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath manager ~ preempted flowmap tasks"), STAT_ManagerPreemptedFlowmapTasks, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath manager ~ fallback steered agents"), STAT_ManagerFallbackSteeredAgents, STATGROUP_FlowPath);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("FlowPath manager ~ queued path requests"), STAT_ManagerQueuedPathRequests, STATGROUP_FlowPath);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("FlowPath manager ~ oldest path request age (ms)"), STAT_ManagerOldestPathRequestAge, STATGROUP_FlowPath);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("FlowPath manager ~ full LOD agents"), STAT_ManagerFullLODAgents, STATGROUP_FlowPath);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("FlowPath manager ~ reduced LOD agents"), STAT_ManagerReducedLODAgents, STATGROUP_FlowPath);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("FlowPath manager ~ coarse LOD agents"), STAT_ManagerCoarseLODAgents, STATGROUP_FlowPath);
+DECLARE_CYCLE_STAT(TEXT("FlowPath manager ~ tile paging"), STAT_ManagerTilePaging, STATGROUP_FlowPath);
+DECLARE_CYCLE_STAT(TEXT("FlowPath manager ~ load baked data"), STAT_ManagerLoadBakedData, STATGROUP_FlowPath);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("FlowPath manager ~ resident tiles"), STAT_ManagerResidentTiles, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath flowmap ~ asynchronous solves"), STAT_AsyncFlowMapSolves, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath manager ~ completed flowmap tasks"), STAT_ManagerCompletedFlowmapTasks, STATGROUP_FlowPath);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("FlowPath manager ~ max flowmap task latency (us)"), STAT_ManagerMaxFlowmapTaskLatency, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath manager ~ routes invalidated by map updates"), STAT_ManagerInvalidatedRoutes, STATGROUP_FlowPath);
+DECLARE_MEMORY_STAT(TEXT("FlowPath waypoint cache"), STAT_WaypointCacheMemory, STATGROUP_FlowPath);
+DECLARE_MEMORY_STAT(TEXT("FlowPath flowmap cache"), STAT_FlowMapCacheMemory, STATGROUP_FlowPath);
+DECLARE_MEMORY_STAT(TEXT("FlowPath flowmap disk cache file"), STAT_DiskCacheFileSize, STATGROUP_FlowPath);
+DECLARE_MEMORY_STAT(TEXT("FlowPath flowmap buffer pool"), STAT_FlowMapPoolMemory, STATGROUP_FlowPath);
+DECLARE_MEMORY_STAT(TEXT("FlowPath tile pool"), STAT_TilePoolMemory, STATGROUP_FlowPath);
+
+// agents that are standing still still get their flowmaps eventually
+const float MinEstimatedCellSpeed = 0.1f;
+
+// the number of agents that are updated together by one worker during the parallel update
+const int32 AgentsPerChunk = 64;
+
+// the number of upcoming waypoints whose tiles are kept resident while paging
+const int32 ResidentWaypointCount = 4;
+
+// the cache sizes are sampled only every few ticks, because all tiles have to be visited
+const int32 CacheSizeSampleTicks = 30;
+
+// only the next few flowmaps of each agent are re-prioritized every tick, the whole routes are rescanned every few ticks
+const int32 PrioritizedFlowMapCount = 3;
+const int32 PriorityRescanTicks = 10;
+
+static FAutoConsoleCommand ChromeTraceStartCommand(
+    TEXT("FlowPath.ChromeTrace.Start"),
+    TEXT("Starts recording the flow path game thread and worker spans. Optional argument: the max number of events."),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+        int32 maxEvents = args.Num() > 0 ? FCString::Atoi(*args[0]) : 0;
+        flow::ChromeTrace::get().start(maxEvents > 0 ? maxEvents : 1000000);
+    }));
+
+static FAutoConsoleCommand ChromeTraceStopCommand(
+    TEXT("FlowPath.ChromeTrace.Stop"),
+    TEXT("Stops recording and writes the Chrome trace event JSON. Optional argument: the file, relative to the saved directory."),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+        FString filename = args.Num() > 0 ? args[0] : TEXT("FlowPathTrace.json");
+        if (FPaths::IsRelative(filename)) {
+            filename = FPaths::Combine(FPaths::ProjectSavedDir(), filename);
+        }
+        if (!flow::ChromeTrace::get().stop(filename)) {
+            UE_LOG(LogExec, Warning, TEXT("No flow path trace was written to %s"), *filename);
+        }
+    }));
+
+static FAutoConsoleCommand DumpCountersCommand(
+    TEXT("FlowPath.Counters"),
+    TEXT("Writes the flow path counters, cache hit rates and histograms to the log."),
+    FConsoleCommandDelegate::CreateLambda([]() {
+        flow::getCounters().log();
+    }));
+
+static FAutoConsoleCommand RequestLatencyCommand(
+    TEXT("FlowPath.RequestLatency"),
+    TEXT("Writes the latency of the agent move orders of all managers, split by cache hits and misses, to the log."),
+    FConsoleCommandDelegate::CreateLambda([]() {
+        auto& counters = flow::getCounters().requestLatency;
+        UE_LOG(LogExec, Display, TEXT("%lld move requests, %lld retries"), counters.moveRequests.GetValue(), counters.moveRequestRetries.GetValue());
+        auto logLatency = [](const TCHAR* name, const flow::Histogram& histogram) {
+            UE_LOG(LogExec, Display, TEXT("%-22s count %lld, mean %.2f ms, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms"), name, histogram.getCount(),
+                histogram.getMean() / 1000, histogram.getPercentile(0.5f) / 1000.0, histogram.getPercentile(0.95f) / 1000.0,
+                histogram.getPercentile(0.99f) / 1000.0, histogram.getMax() / 1000.0);
+        };
+        logLatency(TEXT("Path ready, cache hit"), counters.pathReadyMicrosCacheHit);
+        logLatency(TEXT("Path ready, cache miss"), counters.pathReadyMicrosCacheMiss);
+        logLatency(TEXT("First move, cache hit"), counters.firstMoveMicrosCacheHit);
+        logLatency(TEXT("First move, cache miss"), counters.firstMoveMicrosCacheMiss);
+    }));
+
+static FAutoConsoleCommand ResetCountersCommand(
+    TEXT("FlowPath.Counters.Reset"),
+    TEXT("Resets the flow path counters and histograms."),
+    FConsoleCommandDelegate::CreateLambda([]() {
+        flow::getCounters().reset();
+    }));
 
 using namespace flow;
 
@@ -20,8 +122,24 @@ AFlowPathManager::AFlowPathManager()
     MergingPathSearch = true;
     GeneratorThreadPoolSize = 4;
     MaxAsyncFlowMapUpdatesPerTick = 50;
+    MaxQueuedFlowMapTasks = 1000;
+    UrgentFlowMapTime = 1.0f;
     CleanupFlowmapsAfterTicks = 500;
     CollisionChecking = false;
+    ParallelAgentUpdate = true;
+    AgentLODEnabled = false;
+    FullLODDistance = 2000;
+    ReducedLODDistance = 6000;
+    ReducedLODTickInterval = 4;
+    CoarseLODTickInterval = 8;
+    NonBlockingFlowMapLookup = true;
+    PathRequestBudgetMicroseconds = 2000;
+    SelectedPathRequestBonus = 1.0f;
+    TilePagingEnabled = false;
+    MaxResidentTiles = 1024;
+    BakeFlowMaps = false;
+    MaxFlowMapDiskCacheSizeMB = 512;
+    MaxFlowMapPoolSizeMB = 16;
     ReservedMovementSpeedFactor = 0.5f;
     BlockedMovementSpeedFactor = 0.2f;
 
@@ -140,27 +258,332 @@ void AFlowPathManager::DrawPortalWaypoints(AgentData& data)
 
 #endif		// WITH_EDITOR
 
+const Portal* AFlowPathManager::getLookaheadPortal(const AgentData& data, int32 waypointIndex) const
+{
+    if (!LookaheadFlowmapGeneration || data.waypoints.Num() <= waypointIndex + 3) {
+        return nullptr;
+    }
+    auto lookaheadPortal = data.waypoints[waypointIndex + 3];
+    if (data.waypoints.Num() > waypointIndex + 4 && data.waypoints[waypointIndex + 4]->tileCoordinates == lookaheadPortal->tileCoordinates) {
+        // if possible, jump ahead even more
+        lookaheadPortal = data.waypoints[waypointIndex + 4];
+    }
+    return lookaheadPortal;
+}
+
+float AFlowPathManager::forEachWaypointArrival(const AgentData& data, TFunctionRef<void(int32, float)> callback, int32 waypointCount) const
+{
+    // the arrival time is estimated from the distance along the portal waypoints and the current speed of the agent
+    float speed = FMath::Max(data.cellSpeed, MinEstimatedCellSpeed);
+    FVector2D position = toTile(data.current.agentLocation) * tileLength;
+    float distance = 0;
+    int32 lastWaypoint = data.waypointIndex + FMath::Min(waypointCount, data.waypoints.Num() - data.waypointIndex);
+    for (int32 i = data.waypointIndex; i < lastWaypoint; i++) {
+        auto portal = data.waypoints[i];
+        FVector2D portalPosition = toAbsoluteTileLocationFloat({ portal->tileCoordinates, portal->center });
+        distance += (portalPosition - position).Size();
+        position = portalPosition;
+        callback(i, distance / speed);
+    }
+    return distance / speed;
+}
+
+void AFlowPathManager::forEachUpcomingFlowMap(const AgentData& data, TFunctionRef<void(const Portal*, const Portal*, const Portal*, float)> callback, int32 waypointCount) const
+{
+    forEachWaypointArrival(data, [this, &data, &callback](int32 i, float arrivalTime) {
+        // the flowmap for the portal pair (i + 1, i + 2) is needed as soon as the agent enters the tile through portal i
+        int32 next = i + 1;
+        if ((next - data.waypointIndex) % 2 == 0 && next + 1 < data.waypoints.Num()) {
+            callback(data.waypoints[next], data.waypoints[next + 1], getLookaheadPortal(data, next), arrivalTime);
+        }
+    }, waypointCount);
+}
+
+float AFlowPathManager::estimateTargetArrivalTime(const AgentData& data) const
+{
+    return forEachWaypointArrival(data, [](int32, float) {});
+}
+
 void AFlowPathManager::precomputeFlowmaps(const AgentData& data)
 {
     if (!Pool.IsValid()) {
         return;
     }
 
-    TilePoint target = toTilePoint(data.current.targetLocation);
-    for (int32 i = data.waypointIndex + 2; i < data.waypoints.Num(); i += 2) {
-        generatorTasks.emplace_front(target, data.waypoints, i, LookaheadFlowmapGeneration, *flowPath, tileLock);
-        Pool->AddQueuedWork(&generatorTasks.front());
+    forEachUpcomingFlowMap(data, [this](const Portal* nextPortal, const Portal* connectedPortal, const Portal* lookaheadPortal, float arrivalTime) {
+        requestFlowMap(nextPortal, connectedPortal, lookaheadPortal, arrivalTime);
+    });
+    requestTargetFlowMap(data.currentTarget, estimateTargetArrivalTime(data));
+}
+
+bool AFlowPathManager::requestFlowMap(const Portal* nextPortal, const Portal* connectedPortal, const Portal* lookaheadPortal, float arrivalTime)
+{
+    FlowMapTaskKey key = FlowMapGenerationTask::createKey(nextPortal, connectedPortal, lookaheadPortal);
+    if (flowPath->hasFlowMap(key.portals.targetPortal, key.portals.connectedPortal) || subscribeFlowMapTask(key, arrivalTime)) {
+        return true;
+    }
+    if (!reserveFlowMapTaskSlot(arrivalTime)) {
+        return false;
+    }
+    addFlowMapTask(new FlowMapGenerationTask(nextPortal, connectedPortal, lookaheadPortal, *flowPath, tileLock, completionQueue), arrivalTime);
+    return true;
+}
+
+bool AFlowPathManager::requestTargetFlowMap(const TilePoint& target, float arrivalTime)
+{
+    FlowMapTaskKey key = FlowMapGenerationTask::createTargetKey(target);
+    if (flowPath->hasTargetFlowMap(target) || subscribeFlowMapTask(key, arrivalTime)) {
+        return true;
+    }
+    if (!reserveFlowMapTaskSlot(arrivalTime)) {
+        return false;
+    }
+    addFlowMapTask(new FlowMapGenerationTask(target, *flowPath, tileLock, completionQueue), arrivalTime);
+    return true;
+}
+
+bool AFlowPathManager::subscribeFlowMapTask(const FlowMapTaskKey& key, float arrivalTime)
+{
+    auto existingTask = generatorTasks.Find(key);
+    if (existingTask != nullptr) {
+        // another agent already requested this flowmap, so we just subscribe to the task
+        auto task = existingTask->Get();
+        task->requestCount++;
+        task->priority = FMath::Min(task->priority, arrivalTime);
+        INC_DWORD_STAT(STAT_ManagerMergedFlowmapRequests);
+        getCounters().flowMapTasksMerged.Increment();
+        return true;
+    }
+    return false;
+}
+
+int32 AFlowPathManager::findEvictableFlowMapTask(float arrivalTime) const
+{
+    // only the tasks that are not dispatched yet can be removed, the least urgent one is replaced
+    int32 result = INDEX_NONE;
+    for (int32 i = 0; i < pendingTasks.Num(); i++) {
+        if (pendingTasks[i]->priority > arrivalTime && (result == INDEX_NONE || pendingTasks[i]->priority > pendingTasks[result]->priority)) {
+            result = i;
+        }
+    }
+    return result;
+}
+
+bool AFlowPathManager::hasFlowMapTaskSlot(float arrivalTime) const
+{
+    return generatorTasks.Num() < MaxQueuedFlowMapTasks || (arrivalTime <= 0 && findEvictableFlowMapTask(arrivalTime) != INDEX_NONE);
+}
+
+bool AFlowPathManager::reserveFlowMapTaskSlot(float arrivalTime)
+{
+    if (generatorTasks.Num() < MaxQueuedFlowMapTasks) {
+        return true;
+    }
+
+    // an agent that waits for the flowmap right now replaces a speculative task,
+    // the other requests are dropped and the flowmap is created on demand when an agent reaches the tile
+    int32 evictedIndex = arrivalTime <= 0 ? findEvictableFlowMapTask(arrivalTime) : INDEX_NONE;
+    if (evictedIndex == INDEX_NONE) {
+        INC_DWORD_STAT(STAT_ManagerDroppedFlowmapRequests);
+        getCounters().flowMapTasksDropped.Increment();
+        return false;
     }
+    INC_DWORD_STAT(STAT_ManagerEvictedFlowmapTasks);
+    getCounters().flowMapTasksEvicted.Increment();
+    FlowMapTaskKey evictedKey = pendingTasks[evictedIndex]->key;
+    // the pending queue is re-sorted before the next dispatch
+    pendingTasks.RemoveAtSwap(evictedIndex, 1, false);
+    generatorTasks.Remove(evictedKey);
+    return true;
 }
 
-FlowMapGenerationTask::FlowMapGenerationTask(const TilePoint & target, TArray<const Portal*> waypoints, int32 workIndex, bool lookahead, FlowPath& flowPath, FCriticalSection& tileLock)
-    : target(target), waypoints(waypoints), workIndex(workIndex), lookaheadAllowed(lookahead), flowPath(flowPath), tileLock(tileLock)
+void AFlowPathManager::addFlowMapTask(FlowMapGenerationTask* task, float arrivalTime)
 {
-    if (workIndex + 1 >= waypoints.Num()) {
-        Abandon();
+    task->priority = arrivalTime;
+    task->queuedTime = FPlatformTime::Seconds();
+    getCounters().flowMapTasksQueued.Increment();
+    generatorTasks.Add(task->key, TUniquePtr<FlowMapGenerationTask>(task));
+
+    // the pending queue is re-sorted before the next dispatch
+    pendingTasks.Add(task);
+}
+
+void AFlowPathManager::updateFlowMapPriorities()
+{
+    if (generatorTasks.Num() == 0) {
+        return;
+    }
+
+    // the priorities of the near flowmaps only get more urgent while the agents move towards them, so they are lowered every tick.
+    // a full rescan recalculates all priorities from scratch, as the routes of the agents can have changed since the tasks were requested
+    bool isFullRescan = ++ticksSincePriorityRescan >= PriorityRescanTicks;
+    int32 waypointCount = MAX_int32;
+    if (isFullRescan) {
+        ticksSincePriorityRescan = 0;
+        for (auto& pair : generatorTasks) {
+            pair.Value->priority = MAX_flt;
+            pair.Value->requestCount = 0;
+        }
+    }
+    else {
+        waypointCount = PrioritizedFlowMapCount * 2;
+    }
+    auto updateTask = [this, isFullRescan](const FlowMapTaskKey& key, float arrivalTime) {
+        auto task = generatorTasks.Find(key);
+        if (task != nullptr) {
+            (*task)->priority = FMath::Min((*task)->priority, arrivalTime);
+            if (isFullRescan) {
+                (*task)->requestCount++;
+            }
+        }
+    };
+    for (auto& data : agents) {
+        if (!data.current.isPathfindingActive) {
+            continue;
+        }
+        if (data.waypointIndex + 1 < data.waypoints.Num()) {
+            // the flowmap of the current tile is needed right now
+            updateTask(FlowMapGenerationTask::createKey(data.waypoints[data.waypointIndex], data.waypoints[data.waypointIndex + 1], getLookaheadPortal(data, data.waypointIndex)), 0);
+        }
+        forEachUpcomingFlowMap(data, [&updateTask](const Portal* nextPortal, const Portal* connectedPortal, const Portal* lookaheadPortal, float arrivalTime) {
+            updateTask(FlowMapGenerationTask::createKey(nextPortal, connectedPortal, lookaheadPortal), arrivalTime);
+        }, waypointCount);
+        if (data.waypoints.Num() - data.waypointIndex <= waypointCount) {
+            updateTask(FlowMapGenerationTask::createTargetKey(data.currentTarget), estimateTargetArrivalTime(data));
+        }
+    }
+    if (!isFullRescan) {
+        pendingTasks.Heapify(FlowMapTaskPriority());
         return;
     }
-    workingTile = waypoints[workIndex]->tileCoordinates;
+
+    // tasks that are no longer requested by any agent are not worth the effort
+    for (int32 i = pendingTasks.Num() - 1; i >= 0; i--) {
+        auto task = pendingTasks[i];
+        if (task->requestCount == 0) {
+            FlowMapTaskKey key = task->key;
+            pendingTasks.RemoveAtSwap(i, 1, false);
+            generatorTasks.Remove(key);
+        }
+    }
+    pendingTasks.Heapify(FlowMapTaskPriority());
+}
+
+void AFlowPathManager::dispatchFlowMapTasks()
+{
+    // only a few tasks are handed to the pool at once, so the pool queue does not delay the urgent tasks
+    int32 maxDispatchedTasks = poolThreadCount * 2;
+    while (pendingTasks.Num() > 0) {
+        auto task = pendingTasks.HeapTop();
+        if (dispatchedTasks.Num() >= maxDispatchedTasks) {
+            if (task->priority >= UrgentFlowMapTime || !preemptSpeculativeTask()) {
+                break;
+            }
+        }
+        pendingTasks.HeapPopDiscard(FlowMapTaskPriority(), false);
+        task->isDispatched = true;
+        dispatchedTasks.Add(task);
+        Pool->AddQueuedWork(task);
+    }
+}
+
+bool AFlowPathManager::preemptSpeculativeTask()
+{
+    // find the dispatched task that is needed last and put it back into the pending queue if it has not started yet
+    FlowMapGenerationTask* speculativeTask = nullptr;
+    for (auto task : dispatchedTasks) {
+        if (task->priority >= UrgentFlowMapTime && (speculativeTask == nullptr || task->priority > speculativeTask->priority)) {
+            speculativeTask = task;
+        }
+    }
+    if (speculativeTask == nullptr || !Pool->RetractQueuedWork(speculativeTask)) {
+        return false;
+    }
+
+    INC_DWORD_STAT(STAT_ManagerPreemptedFlowmapTasks);
+    getCounters().flowMapTasksPreempted.Increment();
+    dispatchedTasks.RemoveSingleSwap(speculativeTask, false);
+    speculativeTask->isDispatched = false;
+    pendingTasks.HeapPush(speculativeTask, FlowMapTaskPriority());
+    return true;
+}
+
+void AFlowPathManager::abandonFlowMapTasks(const TSet<FIntPoint>& tileCoordinates)
+{
+    for (auto it = generatorTasks.CreateIterator(); it; ++it) {
+        auto& task = it.Value();
+        if (!task->isUsingTile(tileCoordinates)) {
+            continue;
+        }
+        task->Abandon();
+        getCounters().flowMapTasksAbandoned.Increment();
+        if (!task->isDispatched) {
+            pendingTasks.RemoveSingleSwap(task.Get(), false);
+        }
+        else {
+            dispatchedTasks.RemoveSingleSwap(task.Get(), false);
+            if (!Pool->RetractQueuedWork(task.Get())) {
+                // the task is already running, so we have to keep it alive until it is done
+                abandonedTasks.Add(MoveTemp(task));
+            }
+        }
+        it.RemoveCurrent();
+    }
+}
+
+FlowMapTaskKey FlowMapGenerationTask::createKey(const Portal* nextPortal, const Portal* connectedPortal, const Portal* lookaheadPortal)
+{
+    auto delta = lookaheadPortal == nullptr ? FIntPoint::ZeroValue : lookaheadPortal->tileCoordinates - nextPortal->tileCoordinates;
+    bool usesLookahead = delta.SizeSquared() == 2;
+    FlowMapTaskKey key;
+    key.portals = { nextPortal, usesLookahead ? lookaheadPortal : connectedPortal };
+    key.target = { FIntPoint::ZeroValue, FIntPoint::ZeroValue };
+    return key;
+}
+
+FlowMapTaskKey FlowMapGenerationTask::createTargetKey(const TilePoint& target)
+{
+    FlowMapTaskKey key;
+    key.portals = { nullptr, nullptr };
+    key.target = target;
+    return key;
+}
+
+FlowMapGenerationTask::FlowMapGenerationTask(const Portal* nextPortal, const Portal* connectedPortal, const Portal* lookaheadPortal, FlowPath& flowPath, FCriticalSection& tileLock, FlowMapCompletionQueue& completionQueue)
+    : FlowPathQueuedWork(completionQueue), nextPortal(nextPortal), flowPath(flowPath), tileLock(tileLock), requestCount(1), priority(0), isDispatched(false)
+{
+    key = createKey(nextPortal, connectedPortal, lookaheadPortal);
+    endPortal = key.portals.connectedPortal;
+    workingTile = nextPortal->tileCoordinates;
+    auto delta = endPortal->tileCoordinates - workingTile;
+    usesLookahead = delta.SizeSquared() == 2;
+
+    // remember all tiles the task depends on, as the portal pointers become invalid when one of them is updated
+    sourceTiles.Add(workingTile);
+    sourceTiles.AddUnique(connectedPortal->tileCoordinates);
+    if (usesLookahead) {
+        sourceTiles.AddUnique(workingTile + FIntPoint(delta.X, 0));
+        sourceTiles.AddUnique(workingTile + FIntPoint(0, delta.Y));
+        sourceTiles.AddUnique(endPortal->tileCoordinates);
+    }
+}
+
+FlowMapGenerationTask::FlowMapGenerationTask(const TilePoint& target, FlowPath& flowPath, FCriticalSection& tileLock, FlowMapCompletionQueue& completionQueue)
+    : FlowPathQueuedWork(completionQueue), nextPortal(nullptr), endPortal(nullptr), usesLookahead(false), flowPath(flowPath), tileLock(tileLock), requestCount(1), priority(0), isDispatched(false)
+{
+    key = createTargetKey(target);
+    workingTile = target.tileLocation;
+    sourceTiles.Add(workingTile);
+}
+
+bool FlowMapGenerationTask::isUsingTile(const TSet<FIntPoint>& tiles) const
+{
+    for (auto& tile : sourceTiles) {
+        if (tiles.Contains(tile)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void FlowMapGenerationTask::Abandon()
@@ -170,53 +593,49 @@ void FlowMapGenerationTask::Abandon()
 
 void FlowMapGenerationTask::DoThreadedWork()
 {
+    FLOWPATH_TRACE_SCOPE("Worker.FlowMapTask");
+
     // copy the data while we hold the lock so we do not have to check during the calculation that any pointers or tiles are still valid
     TArray<uint8> sourceData;
     TArray<FIntPoint> targets;
-    bool usesLookahead = false;
-    
+    FIntPoint delta;
+    Orientation portalOrientation = Orientation::NONE;
+
     {
         //TODO this should be a read-write lock for better performance
         FScopeLock lock(&tileLock);
 
-        if (!isAbandoned) {
-            auto nextPortal = waypoints[workIndex];
-            auto connectedPortal = waypoints[workIndex + 1];
-            auto lookaheadPortal = (lookaheadAllowed && waypoints.Num() > workIndex + 3) ? waypoints[workIndex + 3] : nullptr;
-            if (lookaheadPortal != nullptr && waypoints.Num() > workIndex + 4 && waypoints[workIndex + 4]->tileCoordinates == lookaheadPortal->tileCoordinates) {
-                lookaheadPortal = waypoints[workIndex + 4];
+        if (isAbandoned) {
+            // the source tiles have changed, so the task has nothing to do
+        }
+        else if (key.isTargetMap()) {
+            if (!flowPath.hasTargetFlowMap(key.target) && flowPath.copyTileData(workingTile, sourceData)) {
+                targets.Add(key.target.pointInTile);
             }
-            TilePoint location = { workingTile, nextPortal->center };
-            auto delta = lookaheadPortal == nullptr ? FIntPoint::ZeroValue : lookaheadPortal->tileCoordinates - workingTile;
-            usesLookahead = delta.SizeSquared() == 2;
-
-            resultStartPortal = nextPortal;
-            resultEndPortal = usesLookahead ? lookaheadPortal : connectedPortal;
-            if (flowPath.hasFlowMap(nextPortal, resultEndPortal)) {
-                Abandon();
+        }
+        else if (!flowPath.hasFlowMap(nextPortal, endPortal) && nextPortal->parentTile->isResident()) {
+            delta = endPortal->tileCoordinates - workingTile;
+            portalOrientation = nextPortal->orientation;
+            nextPortal->parentTile->calculateFlowmapTargets(nextPortal, endPortal, targets);
+            if (usesLookahead) {
+                flowPath.createFlowMapSourceData(workingTile, delta, sourceData);
             }
             else {
-                resultStartPortal->parentTile->calculateFlowmapTargets(resultStartPortal, resultEndPortal, targets);
-                if (usesLookahead) {
-                    flowPath.createFlowMapSourceData(workingTile, delta, sourceData);
-                }
-                else {
-                    sourceData = nextPortal->parentTile->getData();
-                }
+                nextPortal->parentTile->copyData(sourceData);
             }
         }
     }
 
     if (sourceData.Num() > 0 && targets.Num() > 0) {
-        result = CreateEikonalSurface(sourceData, targets);
+        result = CreateCachedEikonalSurface(sourceData, targets, flowPath.getDiskCache());
+        INC_DWORD_STAT(STAT_AsyncFlowMapSolves);
+        getCounters().asyncFlowMapSolves.Increment();
 
         if (result.Num() > 0) {
             int32 tileLength = flowPath.getTileLength();
             if (usesLookahead) {
                 // extract the important part from the 2x2 tile
-                auto delta = resultEndPortal->tileCoordinates - workingTile;
-                TArray<EikonalCellValue> extractedMap;
-                extractedMap.AddUninitialized(tileLength * tileLength);
+                TArray<EikonalCellValue> extractedMap = getFlowMapPool().acquire(tileLength * tileLength);
                 for (int32 y = 0; y < tileLength; y++) {
                     for (int32 x = 0; x < tileLength; x++) {
                         int32 sourceIndex = toFourTileIndex(delta.X == -1, delta.Y == -1, x, y, tileLength);
@@ -224,19 +643,93 @@ void FlowMapGenerationTask::DoThreadedWork()
                         extractedMap[targetIndex] = result[sourceIndex];
                     }
                 }
-                result = extractedMap;
+                getFlowMapPool().release(MoveTemp(result));
+                result = MoveTemp(extractedMap);
             }
-            else {
+            else if (!key.isTargetMap()) {
                 for (auto p : targets) {
                     // Change values for the portal window, so that an agent will pass to the next tile.
                     int32 index = p.X + p.Y * tileLength;
-                    result[index].directionLookupIndex = toDirectionIndex(resultStartPortal->orientation);
+                    result[index].directionLookupIndex = toDirectionIndex(portalOrientation);
                 }
             }
         }
     }
 
-    isDone = true;
+    complete();
+}
+
+TileBuildTask::TileBuildTask(const FIntPoint& tileCoordinates, const TArray<uint8>& tileData, uint32 version, FlowPath& flowPath, TileBuildCompletionQueue& completionQueue)
+    : FlowPathQueuedWork(completionQueue), flowPath(flowPath), tileCoordinates(tileCoordinates), tileData(tileData), version(version)
+{
+}
+
+void TileBuildTask::DoThreadedWork()
+{
+    FLOWPATH_TRACE_SCOPE("Worker.TileBuild");
+
+    // the task only works on its own copy of the data, so no lock is needed
+    result.Reset(flowPath.createTile(tileCoordinates, tileData));
+    getCounters().tileBuilds.Increment();
+
+    complete();
+}
+
+TilePagingTask::TilePagingTask(TilePagingBatch&& batch, FlowPath& flowPath, TilePagingCompletionQueue& completionQueue)
+    : FlowPathQueuedWork(completionQueue), flowPath(flowPath), batch(MoveTemp(batch))
+{
+}
+
+void TilePagingTask::DoThreadedWork()
+{
+    FLOWPATH_TRACE_SCOPE("Worker.TilePaging");
+
+    // only the tile store is accessed, so no lock is needed
+    flowPath.transferTiles(batch);
+
+    complete();
+}
+
+void AFlowPathManager::processTilePaging()
+{
+    TilePagingTask* task;
+    while (tilePagingQueue.Dequeue(task)) {
+        int32 index = tilePagingTasks.IndexOfByPredicate([task](const TUniquePtr<TilePagingTask>& pending) { return pending.Get() == task; });
+        check(index != INDEX_NONE);
+        {
+            FScopeLock lock(&tileLock);
+            flowPath->applyTilePaging(task->batch);
+        }
+        tilePagingTasks.RemoveAtSwap(index, 1, false);
+    }
+}
+
+void AFlowPathManager::processTileBuilds()
+{
+    TileBuildTask* task;
+    while (tileBuildQueue.Dequeue(task)) {
+        int32 index = tileBuildTasks.IndexOfByPredicate([task](const TUniquePtr<TileBuildTask>& pending) { return pending.Get() == task; });
+        check(index != INDEX_NONE);
+        TUniquePtr<TileBuildTask> finishedTask = MoveTemp(tileBuildTasks[index]);
+        tileBuildTasks.RemoveAtSwap(index, 1, false);
+
+        FIntPoint tileCoord = finishedTask->tileCoordinates;
+        if (tileVersions.FindRef(tileCoord) != finishedTask->version) {
+            OnTileUpdated.Broadcast(tileCoord.X, tileCoord.Y, false);
+            continue;
+        }
+
+        // the staged change owns the tile until it is published
+        FlowTile* builtTile = finishedTask->result.Release();
+        stageMapUpdate([this, builtTile, tileCoord]() {
+            auto originalTilePortals = flowPath->getAllTilePortals(tileCoord);
+            flowPath->publishTile(TUniquePtr<FlowTile>(builtTile));
+            occupancy->addTile(tileCoord);
+            invalidateUpdatedTile(tileCoord, CellUpdateResult::TileRebuilt, originalTilePortals);
+            return true;
+        });
+        OnTileUpdated.Broadcast(tileCoord.X, tileCoord.Y, true);
+    }
 }
 
 void AFlowPathManager::processFlowMapGenerators()
@@ -244,29 +737,61 @@ void AFlowPathManager::processFlowMapGenerators()
     if (!Pool.IsValid()) {
         return;
     }
-     
+    FLOWPATH_TRACE_SCOPE("Manager.FlowMapCompletion");
+
+    // only the finished tasks are in the queue, so the work done here does not depend on the number of pending tasks
+    FlowMapGenerationTask* task;
     int32 count = 0;
-    for (auto it = generatorTasks.begin(); it != generatorTasks.end() && count < MaxAsyncFlowMapUpdatesPerTick;) {
-        const auto& task = *it;
-        if (task.isDone) {
-            if (!task.isAbandoned && task.result.Num() > 0) {
-                flowPath->cacheFlowMap(task.resultStartPortal, task.resultEndPortal, task.result);
-                count++;
-            }
-            it = generatorTasks.erase(it);
+    double now = FPlatformTime::Seconds();
+    int64 maxLatency = 0;
+    while (count < MaxAsyncFlowMapUpdatesPerTick && completionQueue.Dequeue(task)) {
+        if (task->isAbandoned) {
+            abandonedTasks.RemoveAll([task](const TUniquePtr<FlowMapGenerationTask>& abandoned) { return abandoned.Get() == task; });
+            continue;
         }
-        else {
-            it++;
+        if (task->result.Num() > 0 && task->key.isTargetMap()) {
+            flowPath->cacheTargetFlowMap(task->key.target, MoveTemp(task->result));
+        }
+        else if (task->result.Num() > 0) {
+            flowPath->cacheFlowMap(task->key.portals.targetPortal, task->key.portals.connectedPortal, MoveTemp(task->result));
         }
+        count++;
+        int64 latency = static_cast<int64>((now - task->queuedTime) * 1000000);
+        maxLatency = FMath::Max(maxLatency, latency);
+        getCounters().flowMapTaskLatencyMicros.add(latency);
+        INC_DWORD_STAT(STAT_ManagerCompletedFlowmapTasks);
+        getCounters().flowMapTasksCompleted.Increment();
+        FlowMapTaskKey key = task->key;
+        dispatchedTasks.RemoveSingleSwap(task, false);
+        generatorTasks.Remove(key);
     }
+
+    updateFlowMapPriorities();
+    dispatchFlowMapTasks();
+    SET_DWORD_STAT(STAT_ManagerQueuedFlowmapTasks, generatorTasks.Num());
+    SET_DWORD_STAT(STAT_ManagerMaxFlowmapTaskLatency, static_cast<uint32>(maxLatency));
+    getCounters().flowMapQueueDepth.add(generatorTasks.Num());
+    ChromeTrace::get().addCounter(TEXT("Queued flowmap tasks"), generatorTasks.Num());
 }
 
 void AFlowPathManager::Tick(float DeltaTime)
 {
     SCOPE_CYCLE_COUNTER(STAT_ManagerTick);
+    FLOWPATH_TRACE_SCOPE("Manager.Tick");
+    tickStartTime = FPlatformTime::Seconds();
 
     Super::Tick(DeltaTime);
 
+    if (isRecordingInput()) {
+        traceWriter->writeConfig(getTraceConfig());
+    }
+    TGuardValue<bool> traceGuard(isTraceSuspended, true);
+
+    if (mapUpdateDepth > 0) {
+        UE_LOG(LogExec, Warning, TEXT("The flow path map update was not committed before the tick."));
+        commitOpenMapUpdates();
+    }
+    processTileBuilds();
     processFlowMapGenerators();
 
 #if WITH_EDITOR
@@ -281,177 +806,637 @@ void AFlowPathManager::Tick(float DeltaTime)
     }
 #endif		// WITH_EDITOR
 
+    // write the data of the interface agents into the agent buffers, the interface calls are only allowed on the game thread
     TArray<UObject*> agentsToRemove;
-    blockedCells.Empty(agents.Num());
-    reservedCells.Empty(agents.Num());
-    for (auto& agentPair : agents) {
-        UObject* agent = agentPair.Key;
-        AgentData& data = agentPair.Value;
-
-        if (!agent->IsValidLowLevelFast() || agent->IsPendingKill()) {
-            agentsToRemove.Add(agent);
-            continue;
-        }
+    for (auto& data : agents) {
 #if WITH_EDITOR
         DrawPortalWaypoints(data);
 #endif		// WITH_EDITOR
-
-        data.lastTick = data.current;
-        data.lastLocation = data.currentLocation;
-        data.lastTarget = data.currentTarget;
-        data.current = INavAgent::Execute_GetAgentInfo(agent);
-        data.currentLocation = toTilePoint(data.current.agentLocation);
-        data.currentTarget = toTilePoint(data.current.targetLocation);
-        blockedCells.Add(toAbsoluteTileLocation(data.currentLocation));
-
-        bool isActive = data.current.isPathfindingActive;
-        if (isActive) {
-            if ((data.current.targetLocation - data.current.agentLocation).SizeSquared() <= (AcceptanceRadius * AcceptanceRadius)) {
-                // agent has reached the goal
-                data.current.isPathfindingActive = false;
-                data.isPathDataDirty = false;
-                data.targetAcceleration = FVector2D::ZeroVector;
-                data.waypoints.Empty();
-                INavAgent::Execute_TargetReached(agent);
-            }
-            else if (!data.lastTick.isPathfindingActive) {
-                // agent just started the pathfinding
-                data.isPathDataDirty = true;
-                data.targetAcceleration = FVector2D::ZeroVector;
-                data.waypoints.Empty();
-            }
-            else if (!data.isPathDataDirty) {
-                if (data.currentLocation == data.lastLocation && data.currentTarget == data.lastTarget) {
-                    INavAgent::Execute_UpdateAcceleration(agent, data.targetAcceleration);
-                    if (CollisionChecking) {
-                        auto nextTarget = toAbsoluteTileLocationFloat(data.currentLocation) + data.targetAcceleration;
-                        reservedCells.Add(FIntPoint(nextTarget.X, nextTarget.Y), agent);
-                    }
-                }
-                else {
-                    data.isPathDataDirty = true;
-                }
-            }
+        if (data.agent == nullptr) {
+            continue;
+        }
+        if (!data.agent->IsValidLowLevelFast() || data.agent->IsPendingKill()) {
+            agentsToRemove.Add(data.agent);
+            continue;
         }
+
+        FAgentInfo info = INavAgent::Execute_GetAgentInfo(data.agent);
+        agentBuffers.positions[data.handle] = info.agentLocation;
+        agentBuffers.targets[data.handle] = info.targetLocation;
+        agentBuffers.groups[data.handle] = info.groupID;
+        // the other flags are owned by the manager and the outside world, so only the input bit is written
+        uint8& flags = agentBuffers.flags[data.handle];
+        flags = info.isPathfindingActive ? (flags | AgentFlags::PathfindingActive) : (flags & ~AgentFlags::PathfindingActive);
     }
 
     for (auto agent : agentsToRemove) {
-        agents.Remove(agent);
+        RemoveAgent(agent);
+    }
+
+    updateResidentTiles();
+
+    // every agent blocks its own cell and reserves at most one more
+    occupancy->reset(agents.Num() * 2);
+    gatherLODViewers();
+    recordTick(DeltaTime);
+
+    parallelForAgents([this, DeltaTime](AgentData& data) {
+        updateAgentState(data, DeltaTime);
+    });
+
+    // commit the results of the parallel update
+    int32 lodCounts[3] = { 0, 0, 0 };
+    for (auto& data : agents) {
+        lodCounts[static_cast<uint8>(data.lod)]++;
+        if (data.hasReachedTarget) {
+            publishTargetReached(data);
+        }
+        else if (data.isSteady) {
+            publishAcceleration(data);
+        }
     }
+    SET_DWORD_STAT(STAT_ManagerFullLODAgents, lodCounts[static_cast<uint8>(AgentLOD::Full)]);
+    SET_DWORD_STAT(STAT_ManagerReducedLODAgents, lodCounts[static_cast<uint8>(AgentLOD::Reduced)]);
+    SET_DWORD_STAT(STAT_ManagerCoarseLODAgents, lodCounts[static_cast<uint8>(AgentLOD::Coarse)]);
 
     updateDirtyPathData();
     cleanupOldFlowmaps();
+    sampleCacheSizes();
 }
 
-void AFlowPathManager::updateDirtyPathData()
+void AFlowPathManager::parallelForAgents(TFunctionRef<void(AgentData&)> callback)
 {
-    SCOPE_CYCLE_COUNTER(STAT_ManagerDirtyPaths);
-
-    for (auto& agentPair : agents) {
-        AgentData& data = agentPair.Value;
-        if (!data.current.isPathfindingActive || !data.isPathDataDirty) {
-            continue;
+    int32 maxIndex = agents.GetMaxIndex();
+    int32 chunkCount = FMath::DivideAndRoundUp(maxIndex, AgentsPerChunk);
+    ParallelFor(chunkCount, [this, maxIndex, &callback](int32 chunk) {
+        FLOWPATH_TRACE_SCOPE("Manager.AgentChunk");
+        int32 end = FMath::Min(maxIndex, (chunk + 1) * AgentsPerChunk);
+        for (int32 i = chunk * AgentsPerChunk; i < end; i++) {
+            if (agents.IsAllocated(i)) {
+                callback(agents[i]);
+            }
         }
-        auto& location = data.currentLocation;
-        auto& target = data.currentTarget;
+    }, !ParallelAgentUpdate);
+}
+
+void AFlowPathManager::updateAgentState(AgentData& data, float DeltaTime)
+{
+    // read the agent data from the buffers
+    int32 handle = data.handle;
+    uint8 flags = agentBuffers.flags[handle];
+    data.lastTick = data.current;
+    data.lastLocation = data.currentLocation;
+    data.lastTarget = data.currentTarget;
+    data.current.isPathfindingActive = (flags & AgentFlags::PathfindingActive) != 0;
+    data.current.agentLocation = agentBuffers.positions[handle];
+    data.current.targetLocation = agentBuffers.targets[handle];
+    data.current.groupID = agentBuffers.groups[handle];
+
+    data.currentLocation = toTilePoint(data.current.agentLocation);
+    data.currentTarget = toTilePoint(data.current.targetLocation);
+    data.hasReachedTarget = false;
+    data.isSteady = false;
+    if (CollisionChecking) {
+        occupancy->block(data.currentLocation);
+    }
+    if (DeltaTime > 0 && data.current.isPathfindingActive && data.lastTick.isPathfindingActive) {
+        float movedCells = (toTile(data.current.agentLocation) - toTile(data.lastTick.agentLocation)).Size() * tileLength;
+        data.cellSpeed = FMath::Lerp(data.cellSpeed, movedCells / DeltaTime, 0.1f);
+    }
 
-        // check and update the portal waypoint data
-        bool isWaypointDataDirty = target != data.lastTarget || (data.waypointIndex >= data.waypoints.Num() && location.tileLocation != target.tileLocation);
-        if (!isWaypointDataDirty && data.waypoints.Num() > 0 && data.waypoints.Num() > data.waypointIndex) {
-            if (data.waypoints[data.waypointIndex + 1]->tileCoordinates == location.tileLocation) {
-                data.waypointIndex += 2;
-            } else if (data.waypoints[data.waypointIndex]->tileCoordinates != location.tileLocation) {
-                isWaypointDataDirty = true;
+    if (!data.current.isPathfindingActive) {
+        data.lod = AgentLOD::Full;
+        data.moveRequestTime = -1;
+        return;
+    }
+    if (data.moveRequestTime < 0 && (!data.lastTick.isPathfindingActive || data.currentTarget != data.lastTarget)) {
+        // a new move order, a pending one keeps its start time as the agent is still waiting
+        data.moveRequestTime = tickStartTime;
+        data.firstMoveTime = -1;
+        data.isMoveRequestCacheMiss = false;
+        requestLatency.moveRequests.Increment();
+        getCounters().requestLatency.moveRequests.Increment();
+    }
+    AgentLOD lod = calculateLOD(data);
+    if (data.lod == AgentLOD::Coarse && lod != AgentLOD::Coarse) {
+        // promoted agents switch from the coarse steering back to the flowmaps
+        data.isPathDataDirty = true;
+    }
+    data.lod = lod;
+
+    if ((data.current.targetLocation - data.current.agentLocation).SizeSquared() <= (AcceptanceRadius * AcceptanceRadius)) {
+        // agent has reached the goal
+        data.current.isPathfindingActive = false;
+        data.hasReachedTarget = true;
+        data.moveRequestTime = -1;
+        data.isPathDataDirty = false;
+        data.needsPortalSearch = false;
+        data.targetAcceleration = FVector2D::ZeroVector;
+        data.waypoints.Empty();
+    }
+    else if (!data.lastTick.isPathfindingActive) {
+        // agent just started the pathfinding
+        data.isPathDataDirty = true;
+        data.targetAcceleration = FVector2D::ZeroVector;
+        data.waypoints.Empty();
+    }
+    else if (!data.isPathDataDirty) {
+        if (data.currentLocation == data.lastLocation && data.currentTarget == data.lastTarget) {
+            data.isSteady = true;
+            if (CollisionChecking) {
+                occupancy->reserve(getReservationTarget(data), handle);
             }
         }
-        if (isWaypointDataDirty || (data.waypoints.Num() == 0 && location.tileLocation != target.tileLocation)) {
-            auto portalSearchResult = flowPath->findPortalPath(location, target, MergingPathSearch);
-            if (!portalSearchResult.success) {
-                data.current.isPathfindingActive = false;
-                data.targetAcceleration = FVector2D::ZeroVector;
-                data.isPathDataDirty = false;
-                data.waypoints.Empty();
-                INavAgent::Execute_TargetUnreachable(agentPair.Key);
-                continue;
-            }
-            data.waypoints = portalSearchResult.waypoints;
-            data.waypointIndex = 0;
-            precomputeFlowmaps(data);
+        else {
+            data.isPathDataDirty = true;
         }
+    }
+}
 
-        bool followingPortals = data.waypointIndex < data.waypoints.Num();
-        auto nextPortal = followingPortals ? data.waypoints[data.waypointIndex] : nullptr;
-        auto connectedPortal = followingPortals ? data.waypoints[data.waypointIndex + 1] : nullptr;
-        auto lookaheadPortal = (LookaheadFlowmapGeneration && followingPortals && data.waypoints.Num() > data.waypointIndex + 3) ? data.waypoints[data.waypointIndex + 3] : nullptr;
-        if (lookaheadPortal != nullptr && data.waypoints.Num() > data.waypointIndex + 4 && data.waypoints[data.waypointIndex + 4]->tileCoordinates == lookaheadPortal->tileCoordinates) {
-            // if possible, jump ahead even more
-            lookaheadPortal = data.waypoints[data.waypointIndex + 4];
-        }
+void AFlowPathManager::updateResidentTiles()
+{
+    if (!flowPath->isPagingEnabled()) {
+        return;
+    }
+    SCOPE_CYCLE_COUNTER(STAT_ManagerTilePaging);
+    FLOWPATH_TRACE_SCOPE("Manager.TilePaging");
 
-        int32 lookupIndex = flowPath->fastFlowMapLookup({ location, target }, nextPortal, connectedPortal, lookaheadPortal);
-        if (lookupIndex < 0) {
-            UE_LOG(LogExec, Warning, TEXT("Unable to calculate flowmap value for agent %s, resetting pathfinding"), *agentPair.Key->GetFullName());
-            data.targetAcceleration = FVector2D::ZeroVector;
-            data.isPathDataDirty = true;
-            data.waypoints.Empty();
-            INavAgent::Execute_UpdateAcceleration(agentPair.Key, data.targetAcceleration);
-            continue;
-        }
+    processTilePaging();
 
-        if (!CollisionChecking) {
-            data.targetAcceleration = normalizedNeighbors[lookupIndex];
-        } else {
-            auto absLocation = toAbsoluteTileLocation(data.currentLocation);
-            auto nextLocation = absLocation + neighbors[lookupIndex];
-            auto reservedAgent = reservedCells.Find(nextLocation);
-            if (!blockedCells.Contains(nextLocation) && (reservedAgent == nullptr || *reservedAgent == agentPair.Key)) {
-                data.targetAcceleration = normalizedNeighbors[lookupIndex];
-            } else {
-                // the target we want to steer to is blocked by another agent, so we try to steer to an adjacent tile if possible
-                float accelerationFactor = BlockedMovementSpeedFactor; 
-                for (auto& alternative : getAdjacentFreePoints(data.currentLocation, lookupIndex)) {
-                    absLocation = toAbsoluteTileLocation(alternative.Key);
-                    if (blockedCells.Contains(absLocation)) {
-                        // If we steer to a blocked cell without any alternative we slow down
-                        continue;
-                    }
-                    reservedAgent = reservedCells.Find(absLocation);
-                    if (reservedAgent != nullptr && *reservedAgent != agentPair.Key) {
-                        // reserved cells are avoided as much as possible, but sometimes they are the only things left
-                        lookupIndex = alternative.Value;
-                        accelerationFactor = ReservedMovementSpeedFactor;
-                        continue;
-                    }
-                    // looks like this cell is free
-                    lookupIndex = alternative.Value;
-                    accelerationFactor = 1;
-                    break;
-                }
-                if (accelerationFactor != 1) {
-                    UE_LOG(LogExec, Warning, TEXT("Factor %f"), accelerationFactor);
-                }
-                data.targetAcceleration = normalizedNeighbors[lookupIndex] * accelerationFactor;
+    // the tiles around the agents, their targets and upcoming waypoints and the tiles of the queued flowmap tasks are needed soon
+    // only the tiles of the agents and their targets are required this tick, the others are prefetched in the background
+    TSet<FIntPoint> usedTiles;
+    TSet<FIntPoint> requiredTiles;
+    for (auto& data : agents) {
+        FIntPoint agentTile = toTilePoint(agentBuffers.positions[data.handle]).tileLocation;
+        FIntPoint targetTile = toTilePoint(agentBuffers.targets[data.handle]).tileLocation;
+        for (int32 y = -1; y <= 1; y++) {
+            for (int32 x = -1; x <= 1; x++) {
+                usedTiles.Add(agentTile + FIntPoint(x, y));
             }
-            auto nextTarget = toAbsoluteTileLocationFloat(data.currentLocation) + data.targetAcceleration;
-            reservedCells.Add(FIntPoint(nextTarget.X, nextTarget.Y), agentPair.Key);
         }
+        usedTiles.Add(targetTile);
+        requiredTiles.Add(agentTile);
+        requiredTiles.Add(targetTile);
+        int32 lastWaypoint = FMath::Min(data.waypointIndex + ResidentWaypointCount, data.waypoints.Num());
+        for (int32 i = data.waypointIndex; i < lastWaypoint; i++) {
+            usedTiles.Add(data.waypoints[i]->tileCoordinates);
+        }
+    }
+    for (auto& task : generatorTasks) {
+        usedTiles.Append(task.Value->sourceTiles);
+    }
 
-        data.isPathDataDirty = false;
-        INavAgent::Execute_UpdateAcceleration(agentPair.Key, data.targetAcceleration);
+    TilePagingBatch requiredBatch;
+    TilePagingBatch prefetchBatch;
+    {
+        // the generator threads read the tile data while holding the lock
+        FScopeLock lock(&tileLock);
+        flowPath->planResidentTiles(usedTiles, requiredTiles, MaxResidentTiles, requiredBatch, prefetchBatch);
     }
+
+    transferTilesNow(requiredBatch);
+    if (!prefetchBatch.isEmpty()) {
+        if (Pool.IsValid()) {
+            auto task = new TilePagingTask(MoveTemp(prefetchBatch), *flowPath, tilePagingQueue);
+            tilePagingTasks.Emplace(task);
+            Pool->AddQueuedWork(task);
+        }
+        else {
+            transferTilesNow(prefetchBatch);
+        }
+    }
+    SET_DWORD_STAT(STAT_ManagerResidentTiles, flowPath->getResidentTileCount());
 }
 
-FIntPoint AFlowPathManager::toAbsoluteTileLocation(TilePoint p) const
+void AFlowPathManager::transferTilesNow(TilePagingBatch& batch) const
 {
-    int32 absoluteX = p.tileLocation.X * tileLength + p.pointInTile.X;
-    int32 absoluteY = p.tileLocation.Y * tileLength + p.pointInTile.Y;
-    return FIntPoint(absoluteX, absoluteY);
+    if (batch.isEmpty()) {
+        return;
+    }
+    // the files are read and written without the lock, so the generator threads are not blocked by them
+    flowPath->transferTiles(batch);
+    FScopeLock lock(&tileLock);
+    flowPath->applyTilePaging(batch);
 }
 
-FVector2D AFlowPathManager::toAbsoluteTileLocationFloat(TilePoint p) const
+void AFlowPathManager::loadTilesNow(const TSet<FIntPoint>& tiles) const
 {
-    int32 absoluteX = p.tileLocation.X * tileLength + p.pointInTile.X;
-    int32 absoluteY = p.tileLocation.Y * tileLength + p.pointInTile.Y;
+    if (!flowPath->isPagingEnabled()) {
+        return;
+    }
+    TilePagingBatch batch;
+    {
+        FScopeLock lock(&tileLock);
+        flowPath->planTileLoads(tiles, batch);
+    }
+    transferTilesNow(batch);
+}
+
+void AFlowPathManager::gatherLODViewers()
+{
+    lodTickCounter++;
+    lodViewers.Reset();
+    if (isReplaying) {
+        lodViewers = replayLODViewers;
+        return;
+    }
+    UWorld* world = GetWorld();
+    if (!AgentLODEnabled || world == nullptr) {
+        return;
+    }
+    for (auto iterator = world->GetPlayerControllerIterator(); iterator; ++iterator) {
+        APlayerController* controller = iterator->Get();
+        if (controller == nullptr) {
+            continue;
+        }
+        FVector location;
+        FRotator rotation;
+        controller->GetPlayerViewPoint(location, rotation);
+        lodViewers.Add(FVector2D(location));
+    }
+}
+
+AgentLOD AFlowPathManager::calculateLOD(const AgentData& data) const
+{
+    if (!AgentLODEnabled || data.currentLocation.tileLocation == data.currentTarget.tileLocation) {
+        // the last tile always needs the exact steering
+        return AgentLOD::Full;
+    }
+
+    // without any player view only the visibility decides the detail
+    float distanceSquared = lodViewers.Num() > 0 ? MAX_flt : 0;
+    for (auto& viewer : lodViewers) {
+        distanceSquared = FMath::Min(distanceSquared, (viewer - data.current.agentLocation).SizeSquared());
+    }
+    if (distanceSquared <= FMath::Square(FullLODDistance)) {
+        return AgentLOD::Full;
+    }
+    bool isSeen = (agentBuffers.flags[data.handle] & AgentFlags::Unseen) == 0;
+    if (isSeen && distanceSquared <= FMath::Square(ReducedLODDistance)) {
+        return AgentLOD::Reduced;
+    }
+    return AgentLOD::Coarse;
+}
+
+bool AFlowPathManager::isLODUpdateTick(const AgentData& data) const
+{
+    if (data.needsPortalSearch || data.currentTarget != data.waypointTarget) {
+        // a new move order is never delayed by the tier, the route to the old target is useless
+        return true;
+    }
+    int32 interval = 1;
+    if (data.lod == AgentLOD::Reduced) {
+        interval = ReducedLODTickInterval;
+    }
+    else if (data.lod == AgentLOD::Coarse) {
+        interval = CoarseLODTickInterval;
+    }
+    // the handle staggers the updates, so not all agents of a tier are updated in the same tick
+    return interval <= 1 || (lodTickCounter + data.handle) % interval == 0;
+}
+
+bool AFlowPathManager::updateCoarseSteering(AgentData& data)
+{
+    if (data.waypointIndex + 1 >= data.waypoints.Num()) {
+        return false;
+    }
+    // steer straight to the portal on the other side of the tile border
+    auto connectedPortal = data.waypoints[data.waypointIndex + 1];
+    FVector2D portalLocation = toAbsoluteTileLocationFloat({ connectedPortal->tileCoordinates, connectedPortal->center });
+    data.targetAcceleration = (portalLocation - toAbsoluteTileLocationFloat(data.currentLocation)).GetSafeNormal();
+    data.isPathDataDirty = false;
+    publishAcceleration(data);
+    return true;
+}
+
+void AFlowPathManager::updateDirtyPathData()
+{
+    SCOPE_CYCLE_COUNTER(STAT_ManagerDirtyPaths);
+    FLOWPATH_TRACE_SCOPE("Manager.DirtyPaths");
+
+    // advance the waypoints and read the cached flowmaps in parallel, this does not modify any shared data
+    parallelForAgents([this](AgentData& data) {
+        if (data.current.isPathfindingActive && data.isPathDataDirty && isLODUpdateTick(data)) {
+            updateAgentWaypoints(data);
+        }
+    });
+
+    // everything that modifies the caches or calls the agents is done on the game thread
+    TArray<AgentData*> requests;
+    double now = FPlatformTime::Seconds();
+    for (auto& data : agents) {
+        if (!data.current.isPathfindingActive || !data.isPathDataDirty) {
+            data.pathRequestTime = -1;
+            continue;
+        }
+        if (!isLODUpdateTick(data)) {
+            continue;
+        }
+        // an agent can only wait for the target flowmap if the pool can take the request, otherwise the flowmap is solved within the budget
+        bool canWaitForTarget = data.hasTargetFallbackDirection && (isTargetFlowMapQueued(data.currentTarget) || hasFlowMapTaskSlot(0));
+        bool isCheap = !data.needsPortalSearch && (data.lookupIndex >= 0 || data.lod == AgentLOD::Coarse || canWaitForTarget || data.hasPortalFallbackDirection);
+        if (isCheap) {
+            commitAgentPath(data);
+            data.pathRequestTime = -1;
+        }
+        else {
+            // path searches and flowmap creation are expensive, so they are handled within the time budget
+            if (data.pathRequestTime < 0) {
+                data.pathRequestTime = now;
+            }
+            requests.Add(&data);
+        }
+    }
+    processPathRequests(requests);
+}
+
+void AFlowPathManager::processPathRequests(TArray<AgentData*>& requests)
+{
+    FLOWPATH_TRACE_SCOPE("Manager.PathRequests");
+    double start = FPlatformTime::Seconds();
+    requests.Sort([this, start](const AgentData& a, const AgentData& b) {
+        return getPathRequestPriority(a, start) > getPathRequestPriority(b, start);
+    });
+
+    double budget = PathRequestBudgetMicroseconds / 1000000.0;
+    int32 processed = 0;
+    while (processed < requests.Num()) {
+        if (processed > 0 && budget > 0 && FPlatformTime::Seconds() - start >= budget) {
+            break;
+        }
+        auto data = requests[processed++];
+        commitAgentPath(*data);
+        data->pathRequestTime = -1;
+    }
+
+    // the remaining agents keep their request time and are handled in one of the next ticks
+    double oldestRequestTime = start;
+    for (int32 i = processed; i < requests.Num(); i++) {
+        oldestRequestTime = FMath::Min(oldestRequestTime, requests[i]->pathRequestTime);
+    }
+    SET_DWORD_STAT(STAT_ManagerQueuedPathRequests, requests.Num() - processed);
+    SET_DWORD_STAT(STAT_ManagerOldestPathRequestAge, static_cast<uint32>((start - oldestRequestTime) * 1000));
+}
+
+float AFlowPathManager::getPathRequestPriority(const AgentData& data, double now) const
+{
+    float age = now - data.pathRequestTime;
+    bool isSelected = (agentBuffers.flags[data.handle] & AgentFlags::Selected) != 0;
+    return isSelected ? age + SelectedPathRequestBonus : age;
+}
+
+void AFlowPathManager::updateAgentWaypoints(AgentData& data)
+{
+    auto& location = data.currentLocation;
+    auto& target = data.currentTarget;
+
+    // check and update the portal waypoint data
+    bool isWaypointDataDirty = target != data.waypointTarget || (data.waypointIndex >= data.waypoints.Num() && location.tileLocation != target.tileLocation);
+    if (!isWaypointDataDirty && data.waypoints.Num() > 0 && data.waypoints.Num() > data.waypointIndex) {
+        if (data.waypoints[data.waypointIndex + 1]->tileCoordinates == location.tileLocation) {
+            data.waypointIndex += 2;
+        } else if (data.waypoints[data.waypointIndex]->tileCoordinates != location.tileLocation) {
+            isWaypointDataDirty = true;
+        }
+    }
+    data.needsPortalSearch = data.needsPortalSearch || isWaypointDataDirty || (data.waypoints.Num() == 0 && location.tileLocation != target.tileLocation);
+    data.lookupIndex = data.needsPortalSearch || data.lod == AgentLOD::Coarse ? -1 : lookupFlowMapDirection(data, false);
+    // the line of sight probe decides whether a missing flowmap can wait, otherwise it is solved within the path request budget
+    data.hasPortalFallbackDirection = data.lookupIndex < 0 && !data.needsPortalSearch && data.lod != AgentLOD::Coarse && canUsePortalFallbackSteering(data) &&
+        flowPath->approximatePortalDirection(location, data.waypoints[data.waypointIndex], data.portalFallbackDirection);
+    data.hasTargetFallbackDirection = data.lookupIndex < 0 && !data.needsPortalSearch && data.lod != AgentLOD::Coarse && isWaitingForTargetFlowMap(data) &&
+        flowPath->isInLineOfSight(location, target);
+}
+
+int32 AFlowPathManager::lookupFlowMapDirection(const AgentData& data, bool allowCreation)
+{
+    bool followingPortals = data.waypointIndex < data.waypoints.Num();
+    auto nextPortal = followingPortals ? data.waypoints[data.waypointIndex] : nullptr;
+    auto connectedPortal = followingPortals ? data.waypoints[data.waypointIndex + 1] : nullptr;
+    auto lookaheadPortal = followingPortals ? getLookaheadPortal(data, data.waypointIndex) : nullptr;
+    TileVector vector = { data.currentLocation, data.currentTarget };
+
+    if (allowCreation) {
+        return flowPath->fastFlowMapLookup(vector, nextPortal, connectedPortal, lookaheadPortal);
+    }
+    int32 direction;
+    return flowPath->cachedFlowMapLookup(vector, nextPortal, connectedPortal, lookaheadPortal, direction) ? direction : -1;
+}
+
+void AFlowPathManager::commitAgentPath(AgentData& data)
+{
+    if (data.needsPortalSearch) {
+        auto portalSearchResult = flowPath->findPortalPath(data.currentLocation, data.currentTarget, MergingPathSearch);
+        data.needsPortalSearch = false;
+        data.waypointTarget = data.currentTarget;
+        if (!portalSearchResult.success) {
+            data.moveRequestTime = -1;
+            data.current.isPathfindingActive = false;
+            data.targetAcceleration = FVector2D::ZeroVector;
+            data.isPathDataDirty = false;
+            data.waypoints.Empty();
+            publishTargetUnreachable(data);
+            return;
+        }
+        data.waypoints = portalSearchResult.waypoints;
+        data.waypointIndex = 0;
+        data.hasPortalFallbackDirection = false;
+        data.hasTargetFallbackDirection = false;
+        data.isMoveRequestCacheMiss |= !portalSearchResult.usedCache;
+        if (data.lod != AgentLOD::Coarse) {
+            precomputeFlowmaps(data);
+        }
+    }
+    if (data.lod == AgentLOD::Coarse && updateCoarseSteering(data)) {
+        completeMoveRequest(data);
+        return;
+    }
+    if (data.lookupIndex < 0 && isWaitingForTargetFlowMap(data) && updateTargetFallbackSteering(data)) {
+        data.isMoveRequestCacheMiss = true;
+        return;
+    }
+    if (data.lookupIndex < 0 && canUsePortalFallbackSteering(data) && updatePortalFallbackSteering(data)) {
+        data.isMoveRequestCacheMiss = true;
+        return;
+    }
+
+    int32 lookupIndex = data.lookupIndex;
+    if (lookupIndex < 0) {
+        // the flowmap is not cached yet, so we have to create it right now
+        data.isMoveRequestCacheMiss = true;
+        lookupIndex = lookupFlowMapDirection(data, true);
+    }
+    if (lookupIndex < 0) {
+        UE_LOG(LogExec, Warning, TEXT("Unable to calculate flowmap value for agent %d, resetting pathfinding"), data.handle);
+        if (data.moveRequestTime >= 0) {
+            requestLatency.moveRequestRetries.Increment();
+            getCounters().requestLatency.moveRequestRetries.Increment();
+        }
+        data.targetAcceleration = FVector2D::ZeroVector;
+        data.isPathDataDirty = true;
+        data.waypoints.Empty();
+        publishAcceleration(data);
+        return;
+    }
+
+    if (!CollisionChecking) {
+        data.targetAcceleration = normalizedNeighbors[lookupIndex];
+    } else {
+        TilePoint nextLocation = data.currentLocation;
+        nextLocation.pointInTile += neighbors[lookupIndex];
+        normalizeTilePoint(nextLocation);
+        int32 reservedAgent = occupancy->getReservation(nextLocation);
+        if (!occupancy->isBlocked(nextLocation) && (reservedAgent == INDEX_NONE || reservedAgent == data.handle)) {
+            data.targetAcceleration = normalizedNeighbors[lookupIndex];
+        } else {
+            // the target we want to steer to is blocked by another agent, so we try to steer to an adjacent tile if possible
+            float accelerationFactor = BlockedMovementSpeedFactor; 
+            for (auto& alternative : getAdjacentFreePoints(data.currentLocation, lookupIndex)) {
+                if (occupancy->isBlocked(alternative.Key)) {
+                    // If we steer to a blocked cell without any alternative we slow down
+                    continue;
+                }
+                reservedAgent = occupancy->getReservation(alternative.Key);
+                if (reservedAgent != INDEX_NONE && reservedAgent != data.handle) {
+                    // reserved cells are avoided as much as possible, but sometimes they are the only things left
+                    lookupIndex = alternative.Value;
+                    accelerationFactor = ReservedMovementSpeedFactor;
+                    continue;
+                }
+                // looks like this cell is free
+                lookupIndex = alternative.Value;
+                accelerationFactor = 1;
+                break;
+            }
+            if (accelerationFactor != 1) {
+                UE_LOG(LogExec, Warning, TEXT("Factor %f"), accelerationFactor);
+            }
+            data.targetAcceleration = normalizedNeighbors[lookupIndex] * accelerationFactor;
+        }
+        occupancy->reserve(getReservationTarget(data), data.handle);
+    }
+
+    data.isPathDataDirty = false;
+    publishAcceleration(data);
+    completeMoveRequest(data);
+}
+
+bool AFlowPathManager::isWaitingForTargetFlowMap(const AgentData& data) const
+{
+    bool isInTargetTile = data.waypointIndex >= data.waypoints.Num();
+    return Pool.IsValid() && isInTargetTile && !flowPath->hasTargetFlowMap(data.currentTarget);
+}
+
+bool AFlowPathManager::isTargetFlowMapQueued(const TilePoint& target) const
+{
+    return generatorTasks.Contains(FlowMapGenerationTask::createTargetKey(target));
+}
+
+bool AFlowPathManager::updateTargetFallbackSteering(AgentData& data)
+{
+    if (!data.hasTargetFallbackDirection && !flowPath->isInLineOfSight(data.currentLocation, data.currentTarget)) {
+        // a wall is in the way, so only the flowmap can lead the agent there
+        return false;
+    }
+    if (!requestTargetFlowMap(data.currentTarget, 0)) {
+        // the pool can not take the request, so the flowmap is created right now
+        return false;
+    }
+
+    // steer straight to the target until the flowmap is created by the pool
+    FVector2D direction = toTile(data.current.targetLocation) - toTile(data.current.agentLocation);
+    data.targetAcceleration = direction.GetSafeNormal();
+    // the path data stays dirty, so the flowmap is used as soon as it is cached
+    data.isPathDataDirty = true;
+    publishAcceleration(data);
+    return true;
+}
+
+bool AFlowPathManager::canUsePortalFallbackSteering(const AgentData& data) const
+{
+    return NonBlockingFlowMapLookup && Pool.IsValid() && data.waypointIndex + 1 < data.waypoints.Num();
+}
+
+bool AFlowPathManager::updatePortalFallbackSteering(AgentData& data)
+{
+    auto nextPortal = data.waypoints[data.waypointIndex];
+    FVector2D direction = data.portalFallbackDirection;
+    if (!data.hasPortalFallbackDirection && !flowPath->approximatePortalDirection(data.currentLocation, nextPortal, direction)) {
+        // the window is not visible, so only the flowmap can lead the agent there
+        return false;
+    }
+    requestFlowMap(nextPortal, data.waypoints[data.waypointIndex + 1], getLookaheadPortal(data, data.waypointIndex), 0);
+
+    INC_DWORD_STAT(STAT_ManagerFallbackSteeredAgents);
+    data.targetAcceleration = direction;
+    // the path data stays dirty, so the flowmap is used as soon as it is cached
+    data.isPathDataDirty = true;
+    publishAcceleration(data);
+    return true;
+}
+
+void AFlowPathManager::publishAcceleration(AgentData& data)
+{
+    if (data.moveRequestTime >= 0 && data.firstMoveTime < 0 && !data.targetAcceleration.IsZero()) {
+        data.firstMoveTime = FPlatformTime::Seconds();
+    }
+    agentBuffers.accelerations[data.handle] = data.targetAcceleration;
+    if (data.agent != nullptr) {
+        INavAgent::Execute_UpdateAcceleration(data.agent, data.targetAcceleration);
+    }
+}
+
+void AFlowPathManager::completeMoveRequest(AgentData& data)
+{
+    if (data.moveRequestTime < 0) {
+        return;
+    }
+    double now = FPlatformTime::Seconds();
+    double firstMoveTime = data.firstMoveTime >= 0 ? data.firstMoveTime : now;
+    int64 pathReadyMicros = static_cast<int64>((now - data.moveRequestTime) * 1000000);
+    int64 firstMoveMicros = static_cast<int64>((firstMoveTime - data.moveRequestTime) * 1000000);
+    // the samples go to this manager and to the totals of all managers
+    for (auto latency : { &requestLatency, &getCounters().requestLatency }) {
+        (data.isMoveRequestCacheMiss ? latency->pathReadyMicrosCacheMiss : latency->pathReadyMicrosCacheHit).add(pathReadyMicros);
+        (data.isMoveRequestCacheMiss ? latency->firstMoveMicrosCacheMiss : latency->firstMoveMicrosCacheHit).add(firstMoveMicros);
+    }
+    data.moveRequestTime = -1;
+}
+
+void AFlowPathManager::publishTargetReached(AgentData& data)
+{
+    uint8& flags = agentBuffers.flags[data.handle];
+    flags = (flags & ~(AgentFlags::PathfindingActive | AgentFlags::TargetReached | AgentFlags::TargetUnreachable)) | AgentFlags::TargetReached;
+    agentBuffers.eventSequences[data.handle]++;
+    agentBuffers.accelerations[data.handle] = FVector2D::ZeroVector;
+    if (data.agent != nullptr) {
+        INavAgent::Execute_TargetReached(data.agent);
+    }
+}
+
+void AFlowPathManager::publishTargetUnreachable(AgentData& data)
+{
+    uint8& flags = agentBuffers.flags[data.handle];
+    flags = (flags & ~(AgentFlags::PathfindingActive | AgentFlags::TargetReached | AgentFlags::TargetUnreachable)) | AgentFlags::TargetUnreachable;
+    agentBuffers.eventSequences[data.handle]++;
+    agentBuffers.accelerations[data.handle] = FVector2D::ZeroVector;
+    if (data.agent != nullptr) {
+        INavAgent::Execute_TargetUnreachable(data.agent);
+    }
+}
+
+FIntPoint AFlowPathManager::toAbsoluteTileLocation(TilePoint p) const
+{
+    int32 absoluteX = p.tileLocation.X * tileLength + p.pointInTile.X;
+    int32 absoluteY = p.tileLocation.Y * tileLength + p.pointInTile.Y;
+    return FIntPoint(absoluteX, absoluteY);
+}
+
+FVector2D AFlowPathManager::toAbsoluteTileLocationFloat(TilePoint p) const
+{
+    int32 absoluteX = p.tileLocation.X * tileLength + p.pointInTile.X;
+    int32 absoluteY = p.tileLocation.Y * tileLength + p.pointInTile.Y;
     return FVector2D(absoluteX, absoluteY);
 }
 
@@ -475,43 +1460,35 @@ TilePoint AFlowPathManager::absoluteTilePosToTilePoint(FVector2D tilePos) const
     return { FIntPoint(tileX, tileY), FIntPoint(x, y) };
 }
 
+TilePoint AFlowPathManager::getReservationTarget(const AgentData& data) const
+{
+    auto nextTarget = toAbsoluteTileLocationFloat(data.currentLocation) + data.targetAcceleration;
+    int32 absoluteX = nextTarget.X;
+    int32 absoluteY = nextTarget.Y;
+    int32 tileX = FMath::FloorToInt(absoluteX / float(tileLength));
+    int32 tileY = FMath::FloorToInt(absoluteY / float(tileLength));
+    return { FIntPoint(tileX, tileY), FIntPoint(absoluteX - tileX * tileLength, absoluteY - tileY * tileLength) };
+}
+
 void AFlowPathManager::normalizeTilePoint(TilePoint& p) const {
-    while (p.pointInTile.X < 0) {
-        p.tileLocation.X--;
-        p.pointInTile.X += tileLength;
-    }
-    while (p.pointInTile.X >= tileLength) {
-        p.tileLocation.X++;
-        p.pointInTile.X -= tileLength;
-    }
-    while (p.pointInTile.Y < 0) {
-        p.tileLocation.Y--;
-        p.pointInTile.Y += tileLength;
-    }
-    while (p.pointInTile.Y >= tileLength) {
-        p.tileLocation.Y++;
-        p.pointInTile.Y -= tileLength;
-    }
+    p = flowPath->toTilePoint(p.tileLocation * tileLength + p.pointInTile);
 }
 
 TArray<TPair<TilePoint, int32>> AFlowPathManager::getAdjacentFreePoints(const TilePoint& p, int32 direction) const
 {
     TArray<TPair<TilePoint, int32>> adjacent;
+    FIntPoint cell = p.tileLocation * tileLength + p.pointInTile;
 
-    TilePoint alternative = p;
     int32 alternativeDir = leftDirectionLookup[direction];
-    alternative.pointInTile += neighbors[alternativeDir];
-    normalizeTilePoint(alternative);
-    if (flowPath->getDataFor(alternative) != BLOCKED) {
-        adjacent.Emplace(alternative, alternativeDir);
+    FIntPoint alternative = cell + neighbors[alternativeDir];
+    if (flowPath->getCellData(alternative) != BLOCKED) {
+        adjacent.Emplace(flowPath->toTilePoint(alternative), alternativeDir);
     }
     
-    alternative = p;
     alternativeDir = rightDirectionLookup[direction];
-    alternative.pointInTile += neighbors[alternativeDir];
-    normalizeTilePoint(alternative);
-    if (flowPath->getDataFor(alternative) != BLOCKED) {
-        adjacent.Emplace(alternative, alternativeDir);
+    alternative = cell + neighbors[alternativeDir];
+    if (flowPath->getCellData(alternative) != BLOCKED) {
+        adjacent.Emplace(flowPath->toTilePoint(alternative), alternativeDir);
     }
 
     return adjacent;
@@ -557,8 +1534,7 @@ void AFlowPathManager::cleanupOldFlowmaps()
     }
     //gather currently used tiles from the agent data
     TSet<FIntPoint> usedTiles;
-    for (auto& agentPair : agents) {
-        AgentData& data = agentPair.Value;
+    for (auto& data : agents) {
         usedTiles.Add(data.currentLocation.tileLocation);
         usedTiles.Add(data.currentTarget.tileLocation);
         for (auto& waypoint : data.waypoints) {
@@ -577,22 +1553,164 @@ void AFlowPathManager::cleanupOldFlowmaps()
     ticksSinceLastCleanup = 0;
 }
 
+void AFlowPathManager::sampleCacheSizes()
+{
+    if (++ticksSinceCacheSizeSample < CacheSizeSampleTicks) {
+        return;
+    }
+    ticksSinceCacheSizeSample = 0;
+
+    auto& counters = getCounters();
+    counters.waypointCacheBytes.Set(flowPath->getWaypointCacheSize());
+    counters.flowMapCacheBytes.Set(flowPath->getFlowMapCacheSize());
+    auto diskCache = flowPath->getDiskCache();
+    counters.diskCacheBytes.Set(diskCache != nullptr ? diskCache->getFileSize() : 0);
+    counters.flowMapPoolBytes.Set(getFlowMapPool().getPooledSize());
+    counters.tilePoolBytes.Set(FlowTile::getPooledSize());
+    SET_MEMORY_STAT(STAT_WaypointCacheMemory, counters.waypointCacheBytes.GetValue());
+    SET_MEMORY_STAT(STAT_FlowMapCacheMemory, counters.flowMapCacheBytes.GetValue());
+    SET_MEMORY_STAT(STAT_DiskCacheFileSize, counters.diskCacheBytes.GetValue());
+    SET_MEMORY_STAT(STAT_FlowMapPoolMemory, counters.flowMapPoolBytes.GetValue());
+    SET_MEMORY_STAT(STAT_TilePoolMemory, counters.tilePoolBytes.GetValue());
+}
+
 void AFlowPathManager::InitializeTiles()
 {
+    if (isRecordingInput()) {
+        traceWriter->writeEvent(FlowPathTraceEventType::InitializeTiles);
+    }
+    resetTasks();
+    flowPath = MakeUnique<FlowPath>(tileLength);
+    occupancy = MakeUnique<OccupancyGrid>(tileLength);
+    configureFlowPath();
+}
+
+void AFlowPathManager::resetTasks()
+{
+    commitOpenMapUpdates();
+
+    // stop the old pool first, so no task is running while we delete it
+    Pool.Reset(nullptr);
+    completionQueue.Empty();
+    tileBuildQueue.Empty();
+    tileBuildTasks.Empty();
+    tilePagingQueue.Empty();
+    tilePagingTasks.Empty();
+    tileVersions.Empty();
+    pendingTasks.Empty();
+    dispatchedTasks.Empty();
+    generatorTasks.Empty();
+    abandonedTasks.Empty();
+    poolThreadCount = 0;
+
     if (GeneratorThreadPoolSize > 0) {
         Pool.Reset(FQueuedThreadPool::Allocate());
         if (!Pool->Create(GeneratorThreadPoolSize, 32 * 1024, TPri_BelowNormal)) {
             Pool.Reset(nullptr);
         }
+        else {
+            poolThreadCount = GeneratorThreadPoolSize;
+        }
     }
     else {
         Pool.Reset(nullptr);
     }
-    generatorTasks.clear();
 
     FMatrix2x2 scaleMatrix(WorldToTileScale.X, 0, 0, WorldToTileScale.Y);
     WorldToTileTransform = FTransform2D(scaleMatrix, WorldToTileTranslation);
-    flowPath = MakeUnique<FlowPath>(tileLength);
+}
+
+void AFlowPathManager::configureFlowPath()
+{
+    getFlowMapPool().setMaxPooledSize(SIZE_T(MaxFlowMapPoolSizeMB) * 1024 * 1024);
+    if (TilePagingEnabled) {
+        flowPath->enablePaging(getTileStoreDirectory());
+    }
+    if (!FlowMapDiskCacheFile.IsEmpty()) {
+        FString filename = FPaths::IsRelative(FlowMapDiskCacheFile) ? FPaths::Combine(FPaths::ProjectSavedDir(), FlowMapDiskCacheFile) : FlowMapDiskCacheFile;
+        flowPath->enableDiskCache(filename, int64(MaxFlowMapDiskCacheSizeMB) * 1024 * 1024);
+    }
+}
+
+FString AFlowPathManager::getTileStoreDirectory() const
+{
+    return TileStoreDirectory.IsEmpty() ? FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FlowPath"), GetName()) : TileStoreDirectory;
+}
+
+FString AFlowPathManager::getNavDataPath(const FString& filename) const
+{
+    return FPaths::IsRelative(filename) ? FPaths::Combine(FPaths::ProjectDir(), filename) : filename;
+}
+
+void AFlowPathManager::BeginPlay()
+{
+    Super::BeginPlay();
+
+    if (!BakedNavDataFile.IsEmpty()) {
+        LoadBakedNavData(BakedNavDataFile);
+    }
+}
+
+bool AFlowPathManager::SaveBakedNavData(const FString& filename, bool includeFlowMaps)
+{
+    TArray<uint8> bakedData;
+    FMemoryWriter writer(bakedData);
+    {
+        // writing can page in tiles
+        FScopeLock lock(&tileLock);
+        if (!flowPath->writeBake(writer, includeFlowMaps)) {
+            UE_LOG(LogExec, Error, TEXT("Unable to bake the flow path data."));
+            return false;
+        }
+    }
+    return FFileHelper::SaveArrayToFile(bakedData, *getNavDataPath(filename));
+}
+
+bool AFlowPathManager::LoadBakedNavData(const FString& filename)
+{
+    SCOPE_CYCLE_COUNTER(STAT_ManagerLoadBakedData);
+
+    // the loaded map is recorded as a snapshot, so the replay does not need the file
+    bool isRecorded = isRecordingInput();
+    TGuardValue<bool> traceGuard(isTraceSuspended, true);
+
+    TArray<uint8> bakedData;
+    if (!FFileHelper::LoadFileToArray(bakedData, *getNavDataPath(filename))) {
+        UE_LOG(LogExec, Error, TEXT("Unable to read the baked flow path data from %s."), *filename);
+        return false;
+    }
+    FMemoryReader reader(bakedData);
+    auto loadedPath = MakeUnique<FlowPath>(tileLength);
+    if (!loadedPath->readBake(reader)) {
+        UE_LOG(LogExec, Error, TEXT("The baked flow path data in %s is invalid or was baked with another version or tile length."), *filename);
+        return false;
+    }
+
+    resetTasks();
+    flowPath = MoveTemp(loadedPath);
+    occupancy = MakeUnique<OccupancyGrid>(tileLength);
+    configureFlowPath();
+    for (auto& tileCoord : flowPath->getAllValidTileCoordinates()) {
+        occupancy->addTile(tileCoord);
+    }
+    // the routes of the agents use the portals of the old map
+    for (auto& data : agents) {
+        data.waypoints.Empty();
+        data.isPathDataDirty = true;
+    }
+    if (isRecorded) {
+        recordSnapshot();
+    }
+    return true;
+}
+
+void AFlowPathManager::BakeNavData()
+{
+    if (BakedNavDataFile.IsEmpty()) {
+        UE_LOG(LogExec, Error, TEXT("Set the baked nav data file of the flow path manager before baking."));
+        return;
+    }
+    SaveBakedNavData(BakedNavDataFile, BakeFlowMaps);
 }
 
 bool AFlowPathManager::UpdateMapTileWorld(FVector2D worldPosition, const TArray<uint8>& tileData)
@@ -601,38 +1719,242 @@ bool AFlowPathManager::UpdateMapTileWorld(FVector2D worldPosition, const TArray<
     return UpdateMapTileLocal(FMath::FloorToInt(tilePos.X), FMath::FloorToInt(tilePos.Y), tileData);
 }
 
-bool AFlowPathManager::UpdateMapTileLocal(int32 tileX, int32 tileY, const TArray<uint8>& tileData)
+void AFlowPathManager::BeginMapUpdate()
+{
+    if (isRecordingInput()) {
+        traceWriter->writeEvent(FlowPathTraceEventType::BeginMapUpdate);
+    }
+    mapUpdateDepth++;
+}
+
+void AFlowPathManager::CommitMapUpdate()
+{
+    if (mapUpdateDepth == 0) {
+        return;
+    }
+    if (isRecordingInput()) {
+        traceWriter->writeEvent(FlowPathTraceEventType::CommitMapUpdate);
+    }
+    if (--mapUpdateDepth == 0) {
+        applyStagedMapUpdates();
+    }
+}
+
+bool AFlowPathManager::stageMapUpdate(TFunction<bool()>&& update)
+{
+    stagedMapUpdates.Add(MoveTemp(update));
+    return mapUpdateDepth > 0 || applyStagedMapUpdates();
+}
+
+bool AFlowPathManager::applyStagedMapUpdates()
 {
+    if (stagedMapUpdates.Num() == 0) {
+        return true;
+    }
+    TArray<TFunction<bool()>> updates = MoveTemp(stagedMapUpdates);
+    stagedMapUpdates.Reset();
+
+    // the lock is held while the whole batch is applied, so the generator threads never see a half updated map
     FScopeLock lock(&tileLock);
+    mapUpdateEvictionStart = getCounters().flowMapCacheEvictions.GetValue();
+    flowPath->beginBulkUpdate();
+    bool success = true;
+    for (auto& update : updates) {
+        success &= update();
+    }
+    flowPath->endBulkUpdate();
+    applyMapInvalidation();
+    return success;
+}
+
+void AFlowPathManager::commitOpenMapUpdates()
+{
+    while (mapUpdateDepth > 0) {
+        CommitMapUpdate();
+    }
+}
+
+bool AFlowPathManager::UpdateMapTileLocal(int32 tileX, int32 tileY, const TArray<uint8>& tileData)
+{
+    if (isRecordingInput()) {
+        traceWriter->writeTileUpdate(FlowPathTraceEventType::TileUpdate, FIntPoint(tileX, tileY), tileData);
+    }
+    if (!flowPath->isValidTileData(tileData)) {
+        return false;
+    }
 
     FIntPoint tileCoord(tileX, tileY);
-    auto originalTilePortals = flowPath->getAllTilePortals(tileCoord);
-    bool success = flowPath->updateMapTile(tileX, tileY, tileData);
+    // a pending asynchronous build of the tile is outdated as soon as the update is requested
+    incrementTileVersion(tileCoord);
+    return stageMapUpdate([this, tileCoord, tileData]() {
+        auto originalTilePortals = flowPath->getAllTilePortals(tileCoord);
+        auto result = flowPath->replaceTileData(tileCoord, tileData);
+        if (result != CellUpdateResult::Failed) {
+            occupancy->addTile(tileCoord);
+            invalidateUpdatedTile(tileCoord, result, originalTilePortals);
+        }
+        return result != CellUpdateResult::Failed;
+    });
+}
 
-    if (success) {
-        // remove invalidated waypoint data
-        for (auto& data : agents) {
-            TSet<const Portal*> waypointPortals;
-            waypointPortals.Append(data.Value.waypoints);
-            for (auto& oldPortal : originalTilePortals) {
-                if (waypointPortals.Contains(oldPortal)) {
-                    data.Value.waypoints.Empty();
-                    data.Value.isPathDataDirty = true;
-                    break;
+bool AFlowPathManager::UpdateMapCells(FIntPoint cellOrigin, FIntPoint regionSize, const TArray<uint8>& cellData)
+{
+    {
+        // the region is rejected as a whole, so an invalid cell can not leave a partial update behind
+        FScopeLock lock(&tileLock);
+        if (!flowPath->prepareMapCellsUpdate(cellOrigin, regionSize, cellData)) {
+            return false;
+        }
+    }
+    if (isRecordingInput()) {
+        traceWriter->writeCellUpdate(cellOrigin, regionSize, cellData);
+    }
+    FIntPoint startTile = flowPath->toTilePoint(cellOrigin).tileLocation;
+    FIntPoint endTile = flowPath->toTilePoint(cellOrigin + regionSize - FIntPoint(1, 1)).tileLocation;
+    for (int32 tileY = startTile.Y; tileY <= endTile.Y; tileY++) {
+        for (int32 tileX = startTile.X; tileX <= endTile.X; tileX++) {
+            incrementTileVersion(FIntPoint(tileX, tileY));
+        }
+    }
+    return stageMapUpdate([this, startTile, endTile, cellOrigin, regionSize, cellData]() {
+        bool success = true;
+        for (int32 tileY = startTile.Y; tileY <= endTile.Y; tileY++) {
+            for (int32 tileX = startTile.X; tileX <= endTile.X; tileX++) {
+                FIntPoint tileCoord(tileX, tileY);
+                auto originalTilePortals = flowPath->getAllTilePortals(tileCoord);
+                auto result = flowPath->updateMapCells(tileCoord, cellOrigin, regionSize, cellData);
+                if (result == CellUpdateResult::Failed) {
+                    success = false;
+                }
+                else {
+                    invalidateUpdatedTile(tileCoord, result, originalTilePortals);
                 }
             }
         }
+        return success;
+    });
+}
 
-        if (Pool.IsValid()) {
-            // stop async flowmap tasks working on that tile
-            for (auto& task : generatorTasks) {
-                if (task.workingTile == tileCoord) {
-                    task.Abandon();
+bool AFlowPathManager::UpdateMapTileAsync(int32 tileX, int32 tileY, const TArray<uint8>& tileData)
+{
+    FIntPoint tileCoord(tileX, tileY);
+    if (isRecordingInput()) {
+        traceWriter->writeTileUpdate(FlowPathTraceEventType::TileUpdateAsync, tileCoord, tileData);
+    }
+    TGuardValue<bool> traceGuard(isTraceSuspended, true);
+    if (!Pool.IsValid()) {
+        bool success = UpdateMapTileLocal(tileX, tileY, tileData);
+        if (success) {
+            OnTileUpdated.Broadcast(tileX, tileY, true);
+        }
+        return success;
+    }
+    if (!flowPath->isValidTileData(tileData)) {
+        return false;
+    }
+
+    auto task = new TileBuildTask(tileCoord, tileData, incrementTileVersion(tileCoord), *flowPath, tileBuildQueue);
+    tileBuildTasks.Emplace(task);
+    Pool->AddQueuedWork(task);
+    return true;
+}
+
+uint32 AFlowPathManager::incrementTileVersion(const FIntPoint& tileCoord)
+{
+    return ++tileVersions.FindOrAdd(tileCoord);
+}
+
+void AFlowPathManager::invalidateUpdatedTile(const FIntPoint& tileCoord, CellUpdateResult result, const TArray<const Portal*>& originalTilePortals)
+{
+    // a pending asynchronous build of the tile is outdated now
+    incrementTileVersion(tileCoord);
+
+    // only record the change, the invalidation is done once for the whole map update
+    if (result == CellUpdateResult::Unchanged) {
+        return;
+    }
+    pendingChangedTiles.Add(tileCoord);
+    if (result == CellUpdateResult::TileRebuilt) {
+        pendingRemovedPortals.Append(originalTilePortals);
+    }
+    else if (result == CellUpdateResult::ConnectionsUpdated) {
+        pendingConnectionTiles.Add(tileCoord);
+    }
+}
+
+void AFlowPathManager::applyMapInvalidation()
+{
+    if (pendingChangedTiles.Num() == 0) {
+        return;
+    }
+    FLOWPATH_TRACE_SCOPE("Manager.MapInvalidation");
+
+    // reverse index from the portals to the agents whose route uses them
+    // removed portals are already deleted, so the waypoints are only compared by address until those routes are cleared
+    TMap<const Portal*, TArray<AgentData*>> portalUsers;
+    for (auto& data : agents) {
+        for (auto& waypoint : data.waypoints) {
+            portalUsers.FindOrAdd(waypoint).AddUnique(&data);
+        }
+    }
+    int32 invalidatedRoutes = 0;
+    auto clearRoute = [&invalidatedRoutes](AgentData& data) {
+        if (data.waypoints.Num() > 0) {
+            invalidatedRoutes++;
+        }
+        data.waypoints.Empty();
+        data.isPathDataDirty = true;
+    };
+
+    for (auto& portal : pendingRemovedPortals) {
+        auto users = portalUsers.Find(portal);
+        if (users != nullptr) {
+            for (auto data : *users) {
+                clearRoute(*data);
+            }
+        }
+    }
+
+    // the portals are the same objects, so only the routes that use a removed connection inside the tile are invalid
+    for (auto& tileCoord : pendingConnectionTiles) {
+        for (auto& portal : flowPath->getAllTilePortals(tileCoord)) {
+            auto users = portalUsers.Find(portal);
+            if (users == nullptr) {
+                continue;
+            }
+            for (auto data : *users) {
+                for (int32 i = 1; i + 1 < data->waypoints.Num(); i += 2) {
+                    if (data->waypoints[i] == portal && !portal->connected.Contains(const_cast<Portal*>(data->waypoints[i + 1]))) {
+                        clearRoute(*data);
+                        break;
+                    }
                 }
             }
         }
     }
-    return success;
+
+    // the agents in a changed tile have to look up their flowmap direction again
+    for (auto& data : agents) {
+        if (data.current.isPathfindingActive && pendingChangedTiles.Contains(data.currentLocation.tileLocation)) {
+            data.isPathDataDirty = true;
+        }
+    }
+
+    if (Pool.IsValid()) {
+        // the running tasks might have copied the old cell data or use the old portals
+        abandonFlowMapTasks(pendingChangedTiles);
+    }
+
+    auto& counters = getCounters();
+    INC_DWORD_STAT_BY(STAT_ManagerInvalidatedRoutes, invalidatedRoutes);
+    counters.mapUpdates.Increment();
+    counters.invalidatedRoutes.Add(invalidatedRoutes);
+    counters.invalidatedRoutesPerMapUpdate.add(invalidatedRoutes);
+    counters.evictedFlowMapsPerMapUpdate.add(counters.flowMapCacheEvictions.GetValue() - mapUpdateEvictionStart);
+
+    pendingChangedTiles.Empty();
+    pendingConnectionTiles.Empty();
+    pendingRemovedPortals.Empty();
 }
 
 bool AFlowPathManager::UpdateMapTilesFromTexture(int32 tileXUpperLeft, int32 tileYUpperLeft, UTexture2D* texture)
@@ -656,32 +1978,69 @@ bool AFlowPathManager::UpdateMapTilesFromTexture(int32 tileXUpperLeft, int32 til
     int32 tilesX = FMath::CeilToInt(sizeX * 1.0 / tileLength);
     int32 tilesY = FMath::CeilToInt(sizeY * 1.0 / tileLength);
 
-    TArray<uint8> tileData;
-    tileData.AddUninitialized(tileLength * tileLength);
-    for (int tileY = 0; tileY < tilesY; tileY++) {
-        for (int tileX = 0; tileX < tilesX; tileX++) {
-            for (int y = 0; y < tileLength; y++) {
-                int32 textureY = tileY * tileLength + y;
-                for (int x = 0; x < tileLength; x++) {
-                    int32 textureX = tileX * tileLength + x;
-                    int32 tileIndex = y * tileLength + x;
-                    if (textureY >= sizeY || textureX >= sizeX) {
-                        tileData[tileIndex] = BLOCKED;
-                    }
-                    else {
-                        int32 textureIndex = textureY * sizeX + textureX;
-                        const FColor& colorVal = imageData[textureIndex];
-                        uint32 combined = colorVal.R | colorVal.G | colorVal.B;
-                        tileData[tileIndex] = combined == 0 ? BLOCKED : combined;
-                    }
+    // the cost conversion of each tile is independent, so it is done in parallel
+    TArray<FIntPoint> tileCoordinates;
+    TArray<TArray<uint8>> tilesData;
+    tileCoordinates.SetNumUninitialized(tilesX * tilesY);
+    tilesData.SetNum(tilesX * tilesY);
+    ParallelFor(tilesX * tilesY, [&](int32 tileIndex) {
+        int32 tileX = tileIndex % tilesX;
+        int32 tileY = tileIndex / tilesX;
+        tileCoordinates[tileIndex] = FIntPoint(tileX + tileXUpperLeft, tileY + tileYUpperLeft);
+        auto& tileData = tilesData[tileIndex];
+        tileData.AddUninitialized(tileLength * tileLength);
+        for (int y = 0; y < tileLength; y++) {
+            int32 textureY = tileY * tileLength + y;
+            for (int x = 0; x < tileLength; x++) {
+                int32 textureX = tileX * tileLength + x;
+                int32 cellIndex = y * tileLength + x;
+                if (textureY >= sizeY || textureX >= sizeX) {
+                    tileData[cellIndex] = BLOCKED;
+                }
+                else {
+                    int32 textureIndex = textureY * sizeX + textureX;
+                    const FColor& colorVal = imageData[textureIndex];
+                    uint32 combined = colorVal.R | colorVal.G | colorVal.B;
+                    tileData[cellIndex] = combined == 0 ? BLOCKED : combined;
                 }
             }
-            UpdateMapTileLocal(tileX + tileXUpperLeft, tileY + tileYUpperLeft, tileData);
         }
-    }
-
+    });
     bulkData->Unlock();
-    return true;
+
+    return updateMapTiles(tileCoordinates, tilesData);
+}
+
+bool AFlowPathManager::updateMapTiles(const TArray<FIntPoint>& tileCoordinates, const TArray<TArray<uint8>>& tilesData)
+{
+    if (isRecordingInput()) {
+        traceWriter->writeTilesUpdate(tileCoordinates, tilesData);
+    }
+    for (auto& tileData : tilesData) {
+        if (!flowPath->isValidTileData(tileData)) {
+            return false;
+        }
+    }
+    for (auto& tileCoord : tileCoordinates) {
+        incrementTileVersion(tileCoord);
+    }
+    return stageMapUpdate([this, tileCoordinates, tilesData]() {
+        TArray<TArray<const Portal*>> originalTilePortals;
+        for (auto& tileCoord : tileCoordinates) {
+            originalTilePortals.Add(flowPath->getAllTilePortals(tileCoord));
+        }
+        auto results = flowPath->replaceTilesData(tileCoordinates, tilesData);
+        bool success = true;
+        for (int32 i = 0; i < results.Num(); i++) {
+            if (results[i] == CellUpdateResult::Failed) {
+                success = false;
+                continue;
+            }
+            occupancy->addTile(tileCoordinates[i]);
+            invalidateUpdatedTile(tileCoordinates[i], results[i], originalTilePortals[i]);
+        }
+        return success;
+    });
 }
 
 uint8 AFlowPathManager::GetTileDataForWorldPosition(FVector2D worldPosition)
@@ -706,19 +2065,279 @@ void AFlowPathManager::RegisterAgent(UObject* agent)
         UE_LOG(LogExec, Error, TEXT("Agents registered with flow path manager must implement the INavAgent interface. (%s)"), *agent->GetFName().ToString());
         return;
     }
-    agents.Add(agent);
+    if (agentIndices.Contains(agent)) {
+        return;
+    }
+    int32 handle = CreateAgentHandle();
+    agents[handle].agent = agent;
+    agentIndices.Add(agent, handle);
 }
 
 void AFlowPathManager::RemoveAgent(UObject * agent)
 {
     check(agent);
-    agents.Remove(agent);
+    int32 handle;
+    if (agentIndices.RemoveAndCopyValue(agent, handle)) {
+        if (traceWriter.IsValid()) {
+            traceWriter->writeAgentEvent(FlowPathTraceEventType::AgentReleased, handle);
+        }
+        agents.RemoveAt(handle);
+        agentBuffers.reset(handle);
+    }
+}
+
+int32 AFlowPathManager::CreateAgentHandle()
+{
+    int32 handle = agents.Add(AgentData());
+    agents[handle].handle = handle;
+    agentBuffers.setNum(agents.GetMaxIndex());
+    agentBuffers.reset(handle);
+    if (traceWriter.IsValid()) {
+        traceWriter->writeAgentEvent(FlowPathTraceEventType::AgentCreated, handle);
+    }
+    return handle;
+}
+
+void AFlowPathManager::ReleaseAgentHandle(int32 handle)
+{
+    // the agents that implement the interface are removed with RemoveAgent
+    if (!IsValidAgentHandle(handle) || agents[handle].agent != nullptr) {
+        return;
+    }
+    if (traceWriter.IsValid()) {
+        traceWriter->writeAgentEvent(FlowPathTraceEventType::AgentReleased, handle);
+    }
+    agents.RemoveAt(handle);
+    agentBuffers.reset(handle);
+}
+
+bool AFlowPathManager::IsValidAgentHandle(int32 handle) const
+{
+    return handle >= 0 && handle < agents.GetMaxIndex() && agents.IsAllocated(handle);
+}
+
+AgentBuffers& AFlowPathManager::GetAgentBuffers()
+{
+    return agentBuffers;
+}
+
+void AgentBuffers::setNum(int32 num)
+{
+    if (flags.Num() >= num) {
+        return;
+    }
+    positions.SetNumZeroed(num);
+    targets.SetNumZeroed(num);
+    flags.SetNumZeroed(num);
+    groups.SetNumZeroed(num);
+    accelerations.SetNumZeroed(num);
+    eventSequences.SetNumZeroed(num);
+}
+
+void AgentBuffers::reset(int32 handle)
+{
+    positions[handle] = FVector2D::ZeroVector;
+    targets[handle] = FVector2D::ZeroVector;
+    flags[handle] = 0;
+    groups[handle] = -1;
+    accelerations[handle] = FVector2D::ZeroVector;
+    eventSequences[handle] = 0;
+}
+
+bool AFlowPathManager::isRecordingInput() const
+{
+    return traceWriter.IsValid() && !isTraceSuspended;
+}
+
+TArray<TPair<FString, FString>> AFlowPathManager::getTraceConfig() const
+{
+    TArray<TPair<FString, FString>> config;
+    for (TFieldIterator<UProperty> it(AFlowPathManager::StaticClass(), EFieldIteratorFlags::ExcludeSuper); it; ++it) {
+        if (!it->HasAnyPropertyFlags(CPF_Edit)) {
+            continue;
+        }
+        FString value;
+        it->ExportTextItem(value, it->ContainerPtrToValuePtr<void>(this), nullptr, nullptr, PPF_None);
+        config.Emplace(it->GetName(), value);
+    }
+    return config;
+}
+
+void AFlowPathManager::applyTraceConfig(const TArray<TPair<FString, FString>>& config)
+{
+    for (auto& entry : config) {
+        UProperty* property = FindField<UProperty>(AFlowPathManager::StaticClass(), *entry.Key);
+        if (property == nullptr || !property->HasAnyPropertyFlags(CPF_Edit)) {
+            UE_LOG(LogExec, Warning, TEXT("The recorded flow path property %s does not exist anymore."), *entry.Key);
+            continue;
+        }
+        property->ImportText(*entry.Value, property->ContainerPtrToValuePtr<void>(this), PPF_None, this);
+    }
+#if WITH_EDITOR
+    // there is no viewport to draw into during a replay
+    DrawAllBlockedCells = false;
+    DrawAllPortals = false;
+    DrawAgentPortalWaypoints = false;
+    DrawFlowMaps = false;
+#endif		// WITH_EDITOR
+}
+
+void AFlowPathManager::recordSnapshot()
+{
+    TArray<FIntPoint> tileCoordinates;
+    TArray<TArray<uint8>> tilesData;
+    {
+        FScopeLock lock(&tileLock);
+        for (auto& tileCoord : flowPath->getAllValidTileCoordinates()) {
+            TArray<uint8> tileData;
+            if (flowPath->readTileData(tileCoord, tileData)) {
+                tileCoordinates.Add(tileCoord);
+                tilesData.Add(MoveTemp(tileData));
+            }
+        }
+    }
+    traceWriter->writeSnapshot(tileCoordinates, tilesData);
+}
+
+void AFlowPathManager::recordTick(float DeltaTime)
+{
+    if (!traceWriter.IsValid()) {
+        return;
+    }
+    TArray<TPair<int32, FlowPathTraceAgentInput>> inputs;
+    inputs.Reserve(agents.Num());
+    for (auto& data : agents) {
+        int32 handle = data.handle;
+        FlowPathTraceAgentInput input;
+        input.position = agentBuffers.positions[handle];
+        input.target = agentBuffers.targets[handle];
+        // the output flags of the last tick are no input
+        input.flags = agentBuffers.flags[handle] & ~(AgentFlags::TargetReached | AgentFlags::TargetUnreachable);
+        input.group = agentBuffers.groups[handle];
+        inputs.Emplace(handle, input);
+    }
+    traceWriter->writeTick(DeltaTime, lodViewers, inputs);
+}
+
+bool AFlowPathManager::StartRecording(const FString& filename)
+{
+    StopRecording();
+    commitOpenMapUpdates();
+    FString path = FPaths::IsRelative(filename) ? FPaths::Combine(FPaths::ProjectSavedDir(), filename) : filename;
+    auto writer = MakeUnique<FlowPathTraceWriter>();
+    if (!writer->open(path)) {
+        UE_LOG(LogExec, Error, TEXT("Unable to create the flow path trace %s."), *path);
+        return false;
+    }
+    traceWriter = MoveTemp(writer);
+    traceWriter->writeConfig(getTraceConfig());
+    recordSnapshot();
+    for (auto& data : agents) {
+        traceWriter->writeAgentEvent(FlowPathTraceEventType::AgentCreated, data.handle);
+    }
+    return true;
+}
+
+void AFlowPathManager::StopRecording()
+{
+    traceWriter.Reset();
+}
+
+bool AFlowPathManager::ReplayTraceEvent(const FlowPathTraceEvent& event, const FlowPathTraceReader& reader)
+{
+    isReplaying = true;
+    switch (event.type) {
+    case FlowPathTraceEventType::Config:
+        applyTraceConfig(event.config);
+        return true;
+    case FlowPathTraceEventType::Snapshot:
+        InitializeTiles();
+        for (auto& data : agents) {
+            data.waypoints.Empty();
+            data.isPathDataDirty = true;
+        }
+        return updateMapTiles(event.tileCoordinates, event.tilesData);
+    case FlowPathTraceEventType::InitializeTiles:
+        InitializeTiles();
+        return true;
+    case FlowPathTraceEventType::AgentCreated:
+        replayHandles.Add(event.handle, CreateAgentHandle());
+        return true;
+    case FlowPathTraceEventType::AgentReleased:
+    {
+        int32 handle;
+        if (!replayHandles.RemoveAndCopyValue(event.handle, handle)) {
+            return false;
+        }
+        ReleaseAgentHandle(handle);
+        return true;
+    }
+    case FlowPathTraceEventType::Tick:
+        replayLODViewers = event.lodViewers;
+        for (auto& input : reader.getAgentInputs()) {
+            int32* handle = replayHandles.Find(input.Key);
+            if (handle == nullptr) {
+                return false;
+            }
+            agentBuffers.positions[*handle] = input.Value.position;
+            agentBuffers.targets[*handle] = input.Value.target;
+            agentBuffers.flags[*handle] = input.Value.flags;
+            agentBuffers.groups[*handle] = input.Value.group;
+        }
+        return true;
+    case FlowPathTraceEventType::BeginMapUpdate:
+        BeginMapUpdate();
+        return true;
+    case FlowPathTraceEventType::CommitMapUpdate:
+        CommitMapUpdate();
+        return true;
+    case FlowPathTraceEventType::TileUpdate:
+        return UpdateMapTileLocal(event.tileCoordinates[0].X, event.tileCoordinates[0].Y, event.tilesData[0]);
+    case FlowPathTraceEventType::TileUpdateAsync:
+        return UpdateMapTileAsync(event.tileCoordinates[0].X, event.tileCoordinates[0].Y, event.tilesData[0]);
+    case FlowPathTraceEventType::CellUpdate:
+        return UpdateMapCells(event.origin, event.size, event.tilesData[0]);
+    case FlowPathTraceEventType::TilesUpdate:
+        return updateMapTiles(event.tileCoordinates, event.tilesData);
+    }
+    return false;
+}
+
+static FFlowPathLatencyPercentiles toLatencyPercentiles(const Histogram& histogram)
+{
+    FFlowPathLatencyPercentiles result;
+    result.Count = static_cast<int32>(histogram.getCount());
+    result.MeanMs = histogram.getMean() / 1000;
+    result.P50Ms = histogram.getPercentile(0.5f) / 1000.0f;
+    result.P95Ms = histogram.getPercentile(0.95f) / 1000.0f;
+    result.P99Ms = histogram.getPercentile(0.99f) / 1000.0f;
+    result.MaxMs = histogram.getMax() / 1000.0f;
+    return result;
+}
+
+FFlowPathRequestLatency AFlowPathManager::GetRequestLatency() const
+{
+    FFlowPathRequestLatency result;
+    result.Requests = static_cast<int32>(requestLatency.moveRequests.GetValue());
+    result.Retries = static_cast<int32>(requestLatency.moveRequestRetries.GetValue());
+    result.PathReadyCacheHit = toLatencyPercentiles(requestLatency.pathReadyMicrosCacheHit);
+    result.PathReadyCacheMiss = toLatencyPercentiles(requestLatency.pathReadyMicrosCacheMiss);
+    result.FirstMoveCacheHit = toLatencyPercentiles(requestLatency.firstMoveMicrosCacheHit);
+    result.FirstMoveCacheMiss = toLatencyPercentiles(requestLatency.firstMoveMicrosCacheMiss);
+    return result;
+}
+
+void AFlowPathManager::ResetRequestLatency()
+{
+    requestLatency.reset();
 }
 
 bool AFlowPathManager::IsPathPossible(FVector2D worldPositionStart, FVector2D worldPositionEnd) const
 {
     TilePoint start = toTilePoint(worldPositionStart);
     TilePoint end = toTilePoint(worldPositionEnd);
+    // the search reads the cell data of the start and end tile
+    loadTilesNow({ start.tileLocation, end.tileLocation });
     return flowPath->findPortalPath({ start, end }, true).success;
 }
 
@@ -0,0 +1,159 @@
+// Created by Michael Galetzka - all rights reserved.
+
+#include "FlowPathReplayCommandlet.h"
+#include "FlowPathManager.h"
+#include "FlowPathTrace.h"
+#include "flow/Counters.h"
+#include "flow/ChromeTrace.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+
+using namespace flow;
+
+UFlowPathReplayCommandlet::UFlowPathReplayCommandlet()
+{
+    IsClient = false;
+    IsEditor = false;
+    IsServer = false;
+    LogToConsole = true;
+}
+
+int32 UFlowPathReplayCommandlet::Main(const FString& Params)
+{
+    FString traceFile;
+    if (!FParse::Value(*Params, TEXT("Trace="), traceFile)) {
+        UE_LOG(LogExec, Error, TEXT("Usage: -run=FlowPathReplay -Trace=<file> [-Output=<file>] [-Deterministic] [-ChromeTrace=<file>]"));
+        return 1;
+    }
+    if (FPaths::IsRelative(traceFile)) {
+        traceFile = FPaths::Combine(FPaths::ProjectSavedDir(), traceFile);
+    }
+    FString outputFile = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FlowPathReplay.json"));
+    FParse::Value(*Params, TEXT("Output="), outputFile);
+    bool isDeterministic = FParse::Param(*Params, TEXT("Deterministic"));
+    FString chromeTraceFile;
+    if (FParse::Value(*Params, TEXT("ChromeTrace="), chromeTraceFile) && FPaths::IsRelative(chromeTraceFile)) {
+        chromeTraceFile = FPaths::Combine(FPaths::ProjectSavedDir(), chromeTraceFile);
+    }
+
+    FlowPathTraceReader reader;
+    if (!reader.open(traceFile)) {
+        UE_LOG(LogExec, Error, TEXT("Unable to open the flow path trace %s."), *traceFile);
+        return 1;
+    }
+
+    UWorld* world = UWorld::CreateWorld(EWorldType::Game, false);
+    FWorldContext& worldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+    worldContext.SetCurrentWorld(world);
+    AFlowPathManager* manager = world->SpawnActor<AFlowPathManager>();
+
+    getCounters().reset();
+    if (!chromeTraceFile.IsEmpty()) {
+        ChromeTrace::get().start();
+    }
+    TArray<double> tickMicros;
+    int32 eventCount = 0;
+    int32 failedEvents = 0;
+    FlowPathTraceEvent event;
+    while (reader.readEvent(event)) {
+        eventCount++;
+        if (!manager->ReplayTraceEvent(event, reader)) {
+            failedEvents++;
+        }
+        if (event.type == FlowPathTraceEventType::Config && isDeterministic) {
+            // takes effect when the tiles are initialized by the following snapshot
+            manager->GeneratorThreadPoolSize = 0;
+            manager->ParallelAgentUpdate = false;
+            manager->PathRequestBudgetMicroseconds = 0;
+            manager->FlowMapDiskCacheFile.Empty();
+        }
+        if (event.type == FlowPathTraceEventType::Tick) {
+            double start = FPlatformTime::Seconds();
+            manager->Tick(event.deltaTime);
+            tickMicros.Add((FPlatformTime::Seconds() - start) * 1000000);
+        }
+    }
+    bool isTraceValid = !reader.isError();
+    if (!chromeTraceFile.IsEmpty() && !ChromeTrace::get().stop(chromeTraceFile)) {
+        UE_LOG(LogExec, Warning, TEXT("Unable to write the Chrome trace to %s"), *chromeTraceFile);
+    }
+
+    manager->Destroy();
+    GEngine->DestroyWorldContext(world);
+    world->DestroyWorld(false);
+
+    if (!isTraceValid) {
+        UE_LOG(LogExec, Error, TEXT("The flow path trace %s is invalid after %d events."), *traceFile, eventCount);
+        return 1;
+    }
+
+    auto root = MakeShared<FJsonObject>();
+    root->SetStringField(TEXT("trace"), traceFile);
+    root->SetBoolField(TEXT("deterministic"), isDeterministic);
+    root->SetNumberField(TEXT("events"), eventCount);
+    root->SetNumberField(TEXT("failedEvents"), failedEvents);
+    root->SetNumberField(TEXT("ticks"), tickMicros.Num());
+
+    if (tickMicros.Num() > 0) {
+        double total = 0;
+        for (double sample : tickMicros) {
+            total += sample;
+        }
+        tickMicros.Sort();
+        auto percentile = [&tickMicros](float p) {
+            return tickMicros[FMath::Min(FMath::FloorToInt(p * tickMicros.Num()), tickMicros.Num() - 1)];
+        };
+        auto tickTimes = MakeShared<FJsonObject>();
+        tickTimes->SetNumberField(TEXT("totalMs"), total / 1000);
+        tickTimes->SetNumberField(TEXT("meanUs"), total / tickMicros.Num());
+        tickTimes->SetNumberField(TEXT("minUs"), tickMicros[0]);
+        tickTimes->SetNumberField(TEXT("p50Us"), percentile(0.5f));
+        tickTimes->SetNumberField(TEXT("p95Us"), percentile(0.95f));
+        tickTimes->SetNumberField(TEXT("p99Us"), percentile(0.99f));
+        tickTimes->SetNumberField(TEXT("maxUs"), tickMicros.Last());
+        root->SetObjectField(TEXT("tickTimes"), tickTimes);
+        UE_LOG(LogExec, Display, TEXT("Replayed %d ticks: mean %.2f us, p50 %.2f us, p95 %.2f us, p99 %.2f us, max %.2f us"),
+            tickMicros.Num(), total / tickMicros.Num(), percentile(0.5f), percentile(0.95f), percentile(0.99f), tickMicros.Last());
+    }
+
+    auto& counters = getCounters();
+    auto counterValues = MakeShared<FJsonObject>();
+    counters.forEach([&counterValues](const TCHAR* name, int64 value) {
+        counterValues->SetNumberField(name, value);
+        UE_LOG(LogExec, Display, TEXT("%-24s %lld"), name, value);
+    });
+    root->SetObjectField(TEXT("counters"), counterValues);
+
+    auto rates = MakeShared<FJsonObject>();
+    counters.forEachRate([&rates](const TCHAR* name, double rate) {
+        rates->SetNumberField(name, rate);
+    });
+    root->SetObjectField(TEXT("rates"), rates);
+
+    auto histograms = MakeShared<FJsonObject>();
+    counters.forEachHistogram([&histograms](const TCHAR* name, const Histogram& histogram) {
+        auto values = MakeShared<FJsonObject>();
+        values->SetNumberField(TEXT("count"), histogram.getCount());
+        values->SetNumberField(TEXT("mean"), histogram.getMean());
+        values->SetNumberField(TEXT("p50"), histogram.getPercentile(0.5f));
+        values->SetNumberField(TEXT("p95"), histogram.getPercentile(0.95f));
+        values->SetNumberField(TEXT("p99"), histogram.getPercentile(0.99f));
+        values->SetNumberField(TEXT("max"), histogram.getMax());
+        histograms->SetObjectField(name, values);
+    });
+    root->SetObjectField(TEXT("histograms"), histograms);
+
+    FString json;
+    auto writer = TJsonWriterFactory<>::Create(&json);
+    if (!FJsonSerializer::Serialize(root, writer) || !FFileHelper::SaveStringToFile(json, *outputFile)) {
+        UE_LOG(LogExec, Error, TEXT("Unable to write the replay results to %s"), *outputFile);
+        return 1;
+    }
+    UE_LOG(LogExec, Display, TEXT("Wrote the replay results to %s"), *outputFile);
+    return failedEvents > 0 ? 1 : 0;
+}
@@ -0,0 +1,221 @@
+// Created by Michael Galetzka - all rights reserved.
+
+#include "FlowPathTrace.h"
+#include "HAL/FileManager.h"
+
+// "FPTR" in little endian
+const uint32 TraceMagic = 0x52545046;
+const uint32 TraceVersion = 1;
+
+// the pairs are written as a count followed by the keys and values
+template<typename KeyType, typename ValueType>
+static void serializePairs(FArchive& ar, TArray<TPair<KeyType, ValueType>>& pairs)
+{
+    int32 count = pairs.Num();
+    ar << count;
+    if (ar.IsLoading()) {
+        if (count < 0 || count > ar.TotalSize()) {
+            ar.SetError();
+            return;
+        }
+        pairs.SetNum(count);
+    }
+    for (auto& pair : pairs) {
+        ar << pair.Key << pair.Value;
+    }
+}
+
+FlowPathTraceWriter::~FlowPathTraceWriter()
+{
+    close();
+}
+
+bool FlowPathTraceWriter::open(const FString& filename)
+{
+    close();
+    file.Reset(IFileManager::Get().CreateFileWriter(*filename));
+    if (!file.IsValid()) {
+        return false;
+    }
+    uint32 magic = TraceMagic;
+    uint32 version = TraceVersion;
+    *file << magic << version;
+    return true;
+}
+
+void FlowPathTraceWriter::close()
+{
+    if (file.IsValid()) {
+        file->Close();
+        file.Reset();
+    }
+    lastInputs.Empty();
+    lastConfig.Empty();
+}
+
+bool FlowPathTraceWriter::isOpen() const
+{
+    return file.IsValid();
+}
+
+void FlowPathTraceWriter::beginEvent(FlowPathTraceEventType type)
+{
+    uint8 typeValue = static_cast<uint8>(type);
+    *file << typeValue;
+}
+
+void FlowPathTraceWriter::writeConfig(const TArray<TPair<FString, FString>>& config)
+{
+    if (config == lastConfig) {
+        return;
+    }
+    lastConfig = config;
+    beginEvent(FlowPathTraceEventType::Config);
+    serializePairs(*file, lastConfig);
+}
+
+void FlowPathTraceWriter::writeSnapshot(const TArray<FIntPoint>& tileCoordinates, const TArray<TArray<uint8>>& tilesData)
+{
+    beginEvent(FlowPathTraceEventType::Snapshot);
+    *file << const_cast<TArray<FIntPoint>&>(tileCoordinates) << const_cast<TArray<TArray<uint8>>&>(tilesData);
+}
+
+void FlowPathTraceWriter::writeEvent(FlowPathTraceEventType type)
+{
+    beginEvent(type);
+}
+
+void FlowPathTraceWriter::writeAgentEvent(FlowPathTraceEventType type, int32 handle)
+{
+    check(type == FlowPathTraceEventType::AgentCreated || type == FlowPathTraceEventType::AgentReleased);
+    if (type == FlowPathTraceEventType::AgentCreated) {
+        lastInputs.Add(handle, FlowPathTraceAgentInput());
+    }
+    else {
+        lastInputs.Remove(handle);
+    }
+    beginEvent(type);
+    *file << handle;
+}
+
+void FlowPathTraceWriter::writeTick(float deltaTime, const TArray<FVector2D>& lodViewers, const TArray<TPair<int32, FlowPathTraceAgentInput>>& inputs)
+{
+    TArray<TPair<int32, FlowPathTraceAgentInput>> changedInputs;
+    for (auto& input : inputs) {
+        auto lastInput = lastInputs.Find(input.Key);
+        if (lastInput == nullptr || !(*lastInput == input.Value)) {
+            changedInputs.Add(input);
+            lastInputs.Add(input.Key, input.Value);
+        }
+    }
+
+    beginEvent(FlowPathTraceEventType::Tick);
+    *file << deltaTime << const_cast<TArray<FVector2D>&>(lodViewers);
+    serializePairs(*file, changedInputs);
+}
+
+void FlowPathTraceWriter::writeTileUpdate(FlowPathTraceEventType type, const FIntPoint& tileCoordinates, const TArray<uint8>& tileData)
+{
+    check(type == FlowPathTraceEventType::TileUpdate || type == FlowPathTraceEventType::TileUpdateAsync);
+    beginEvent(type);
+    *file << const_cast<FIntPoint&>(tileCoordinates) << const_cast<TArray<uint8>&>(tileData);
+}
+
+void FlowPathTraceWriter::writeCellUpdate(const FIntPoint& origin, const FIntPoint& size, const TArray<uint8>& cellData)
+{
+    beginEvent(FlowPathTraceEventType::CellUpdate);
+    *file << const_cast<FIntPoint&>(origin) << const_cast<FIntPoint&>(size) << const_cast<TArray<uint8>&>(cellData);
+}
+
+void FlowPathTraceWriter::writeTilesUpdate(const TArray<FIntPoint>& tileCoordinates, const TArray<TArray<uint8>>& tilesData)
+{
+    beginEvent(FlowPathTraceEventType::TilesUpdate);
+    *file << const_cast<TArray<FIntPoint>&>(tileCoordinates) << const_cast<TArray<TArray<uint8>>&>(tilesData);
+}
+
+bool FlowPathTraceReader::open(const FString& filename)
+{
+    inputs.Empty();
+    file.Reset(IFileManager::Get().CreateFileReader(*filename));
+    if (!file.IsValid()) {
+        return false;
+    }
+    uint32 magic = 0;
+    uint32 version = 0;
+    *file << magic << version;
+    if (file->IsError() || magic != TraceMagic || version != TraceVersion) {
+        file.Reset();
+        return false;
+    }
+    return true;
+}
+
+bool FlowPathTraceReader::readEvent(FlowPathTraceEvent& event)
+{
+    if (!file.IsValid() || file->IsError() || file->AtEnd()) {
+        return false;
+    }
+
+    uint8 typeValue = 0;
+    *file << typeValue;
+    event = FlowPathTraceEvent();
+    event.type = static_cast<FlowPathTraceEventType>(typeValue);
+    switch (event.type) {
+    case FlowPathTraceEventType::Config:
+        serializePairs(*file, event.config);
+        break;
+    case FlowPathTraceEventType::Snapshot:
+    case FlowPathTraceEventType::TilesUpdate:
+        *file << event.tileCoordinates << event.tilesData;
+        if (event.tileCoordinates.Num() != event.tilesData.Num()) {
+            file->SetError();
+        }
+        break;
+    case FlowPathTraceEventType::InitializeTiles:
+    case FlowPathTraceEventType::BeginMapUpdate:
+    case FlowPathTraceEventType::CommitMapUpdate:
+        break;
+    case FlowPathTraceEventType::AgentCreated:
+        *file << event.handle;
+        inputs.Add(event.handle, FlowPathTraceAgentInput());
+        break;
+    case FlowPathTraceEventType::AgentReleased:
+        *file << event.handle;
+        inputs.Remove(event.handle);
+        break;
+    case FlowPathTraceEventType::Tick:
+    {
+        TArray<TPair<int32, FlowPathTraceAgentInput>> changedInputs;
+        *file << event.deltaTime << event.lodViewers;
+        serializePairs(*file, changedInputs);
+        for (auto& input : changedInputs) {
+            inputs.Add(input.Key, input.Value);
+        }
+        break;
+    }
+    case FlowPathTraceEventType::TileUpdate:
+    case FlowPathTraceEventType::TileUpdateAsync:
+        event.tileCoordinates.AddDefaulted(1);
+        event.tilesData.AddDefaulted(1);
+        *file << event.tileCoordinates[0] << event.tilesData[0];
+        break;
+    case FlowPathTraceEventType::CellUpdate:
+        event.tilesData.AddDefaulted(1);
+        *file << event.origin << event.size << event.tilesData[0];
+        break;
+    default:
+        file->SetError();
+        break;
+    }
+    return !file->IsError();
+}
+
+bool FlowPathTraceReader::isError() const
+{
+    return !file.IsValid() || file->IsError();
+}
+
+const TMap<int32, FlowPathTraceAgentInput>& FlowPathTraceReader::getAgentInputs() const
+{
+    return inputs;
+}
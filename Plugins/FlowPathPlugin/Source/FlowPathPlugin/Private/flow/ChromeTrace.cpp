@@ -0,0 +1,93 @@
+//
+// Opt-in span recorder that writes the Chrome trace event format.
+//
+
+#include "ChromeTrace.h"
+#include "Misc/FileHelper.h"
+
+using namespace flow;
+
+ChromeTrace& ChromeTrace::get()
+{
+    static ChromeTrace trace;
+    return trace;
+}
+
+void ChromeTrace::start(int32 maxEventCount)
+{
+    FScopeLock scopeLock(&lock);
+    events.Reset();
+    threadNames.Reset();
+    maxEvents = maxEventCount;
+    droppedEvents = 0;
+    startTime = FPlatformTime::Seconds();
+    FPlatformAtomics::InterlockedExchange(&recording, 1);
+}
+
+void ChromeTrace::addEvent(const Event& event)
+{
+    FScopeLock scopeLock(&lock);
+    if (!isRecording()) {
+        return;
+    }
+    if (events.Num() >= maxEvents) {
+        droppedEvents++;
+        return;
+    }
+    events.Add(event);
+    if (!threadNames.Contains(event.threadId)) {
+        threadNames.Add(event.threadId, IsInGameThread() ? FString(TEXT("GameThread")) : FString::Printf(TEXT("Worker %u"), event.threadId));
+    }
+}
+
+void ChromeTrace::addSpan(const TCHAR* name, double start, double end)
+{
+    addEvent({ name, FPlatformTLS::GetCurrentThreadId(), start, end - start, 0 });
+}
+
+void ChromeTrace::addCounter(const TCHAR* name, int64 value)
+{
+    if (isRecording()) {
+        addEvent({ name, FPlatformTLS::GetCurrentThreadId(), FPlatformTime::Seconds(), -1, value });
+    }
+}
+
+bool ChromeTrace::stop(const FString& filename)
+{
+    FScopeLock scopeLock(&lock);
+    if (!isRecording()) {
+        return false;
+    }
+    FPlatformAtomics::InterlockedExchange(&recording, 0);
+
+    // the timestamps are in microseconds since the start of the recording
+    FString json = TEXT("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (auto& thread : threadNames) {
+        json += FString::Printf(TEXT("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n"), thread.Key, *thread.Value);
+    }
+    for (auto& event : events) {
+        double timestamp = (event.start - startTime) * 1000000;
+        if (event.duration < 0) {
+            json += FString::Printf(TEXT("{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"value\":%lld}},\n"),
+                event.name, timestamp, event.threadId, event.value);
+        }
+        else {
+            json += FString::Printf(TEXT("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u},\n"),
+                event.name, timestamp, event.duration * 1000000, event.threadId);
+        }
+    }
+    // the process name comes last, so the list does not end with a comma
+    json += TEXT("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"FlowPath\"}}\n]}\n");
+
+    if (droppedEvents > 0) {
+        UE_LOG(LogExec, Warning, TEXT("The flow path trace dropped %d events after reaching the limit of %d events."), droppedEvents, maxEvents);
+    }
+    int32 eventCount = events.Num();
+    events.Empty();
+    threadNames.Empty();
+    if (eventCount == 0 || !FFileHelper::SaveStringToFile(json, *filename)) {
+        return false;
+    }
+    UE_LOG(LogExec, Display, TEXT("Wrote %d flow path trace events to %s"), eventCount, *filename);
+    return true;
+}
@@ -0,0 +1,73 @@
+//
+// Opt-in span recorder that writes the Chrome trace event format.
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace flow {
+
+    /**
+    * Records the spans of the game thread and the worker threads and writes them as Chrome trace event JSON,
+    * which can be opened with chrome://tracing or Perfetto. Recording is off by default and a disabled span costs a single branch.
+    * Spans and counters can be added from any thread.
+    */
+    class ChromeTrace {
+    private:
+        struct Event {
+            // has to be a string literal, so the recording never copies the name
+            const TCHAR* name;
+            uint32 threadId;
+            double start;
+            // a negative duration marks a counter sample
+            double duration;
+            int64 value;
+        };
+
+        FCriticalSection lock;
+        TArray<Event> events;
+        TMap<uint32, FString> threadNames;
+        double startTime = 0;
+        int32 maxEvents = 0;
+        int32 droppedEvents = 0;
+        volatile int32 recording = 0;
+
+        void addEvent(const Event& event);
+
+    public:
+        static ChromeTrace& get();
+
+        /** Starts a new recording, the events after the first max events are dropped. */
+        void start(int32 maxEventCount = 1000000);
+
+        /** Stops the recording and writes the events to the file. Returns false if nothing was recorded or the file could not be written. */
+        bool stop(const FString& filename);
+
+        bool isRecording() const { return recording != 0; }
+
+        void addSpan(const TCHAR* name, double start, double end);
+
+        /** Adds a sample of a value that is drawn as a graph over time. */
+        void addCounter(const TCHAR* name, int64 value);
+    };
+
+    /** Adds a span for the lifetime of the scope if the trace is recording. */
+    class ChromeTraceScope {
+    private:
+        const TCHAR* name;
+        double start;
+
+    public:
+        explicit ChromeTraceScope(const TCHAR* name) : name(name), start(ChromeTrace::get().isRecording() ? FPlatformTime::Seconds() : -1) {}
+
+        ~ChromeTraceScope()
+        {
+            if (start >= 0) {
+                ChromeTrace::get().addSpan(name, start, FPlatformTime::Seconds());
+            }
+        }
+    };
+}
+
+#define FLOWPATH_TRACE_SCOPE(Name) flow::ChromeTraceScope PREPROCESSOR_JOIN(chromeTraceScope, __LINE__)(TEXT(Name))
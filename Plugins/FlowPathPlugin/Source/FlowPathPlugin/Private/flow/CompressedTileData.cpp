@@ -0,0 +1,83 @@
+//
+// Run-length encoded cell data for mostly uniform tiles.
+//
+
+#include "CompressedTileData.h"
+
+using namespace flow;
+
+bool CompressedTileData::compress(const TArray<uint8>& data, int32 tileLength, CompressedTileData& result)
+{
+    check(data.Num() == tileLength * tileLength);
+    result.reset();
+    result.tileLength = tileLength;
+    result.rowStarts.Reserve(tileLength + 1);
+    int32 maxSize = data.Num() / 2;
+    for (int32 y = 0; y < tileLength; y++) {
+        result.rowStarts.Add(result.runs.Num());
+        const uint8* row = &data[y * tileLength];
+        int32 x = 0;
+        while (x < tileLength) {
+            uint8 value = row[x];
+            int32 length = 1;
+            while (x + length < tileLength && row[x + length] == value && length < 255) {
+                length++;
+            }
+            result.runs.Add(static_cast<uint8>(length));
+            result.runs.Add(value);
+            x += length;
+        }
+        if (result.getAllocatedSize() > maxSize) {
+            // too many obstacles, the plain data is smaller
+            result.reset();
+            return false;
+        }
+    }
+    result.rowStarts.Add(result.runs.Num());
+    result.runs.Shrink();
+    return true;
+}
+
+bool CompressedTileData::isEmpty() const
+{
+    return rowStarts.Num() == 0;
+}
+
+void CompressedTileData::reset()
+{
+    runs.Empty();
+    rowStarts.Empty();
+}
+
+void CompressedTileData::decode(TArray<uint8>& result) const
+{
+    result.SetNumUninitialized(tileLength * tileLength);
+    for (int32 y = 0; y < tileLength; y++) {
+        decodeRow(y, &result[y * tileLength]);
+    }
+}
+
+void CompressedTileData::decodeRow(int32 y, uint8* result) const
+{
+    for (int32 i = rowStarts[y]; i < rowStarts[y + 1]; i += 2) {
+        FMemory::Memset(result, runs[i + 1], runs[i]);
+        result += runs[i];
+    }
+}
+
+uint8 CompressedTileData::getCell(int32 x, int32 y) const
+{
+    for (int32 i = rowStarts[y]; i < rowStarts[y + 1]; i += 2) {
+        x -= runs[i];
+        if (x < 0) {
+            return runs[i + 1];
+        }
+    }
+    check(false);
+    return 0;
+}
+
+int32 CompressedTileData::getAllocatedSize() const
+{
+    return runs.Num() + rowStarts.Num() * sizeof(int32);
+}
@@ -0,0 +1,37 @@
+//
+// Run-length encoded cell data for mostly uniform tiles.
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace flow {
+
+    /** The cells of a tile as runs of equal values per row, so a single row or cell can be decoded without decoding the whole tile. */
+    class CompressedTileData {
+    private:
+        // pairs of run length and value
+        TArray<uint8> runs;
+        // the first run of each row in the runs array, with an additional entry for the end of the last row
+        TArray<int32> rowStarts;
+        int32 tileLength = 0;
+
+    public:
+        /** Compresses the data if the runs need less than half of the memory. Returns false and leaves the result empty otherwise. */
+        static bool compress(const TArray<uint8>& data, int32 tileLength, CompressedTileData& result);
+
+        bool isEmpty() const;
+
+        void reset();
+
+        void decode(TArray<uint8>& result) const;
+
+        void decodeRow(int32 y, uint8* result) const;
+
+        uint8 getCell(int32 x, int32 y) const;
+
+        /** Returns the memory used by the runs in bytes. */
+        int32 getAllocatedSize() const;
+    };
+}
@@ -0,0 +1,222 @@
+//
+// Event counters for the pathfinding hot paths.
+//
+
+#include "Counters.h"
+
+DEFINE_STAT(STAT_FlowMapCacheHits);
+DEFINE_STAT(STAT_FlowMapCacheEvictions);
+
+using namespace flow;
+
+Counters& flow::getCounters()
+{
+    static Counters counters;
+    return counters;
+}
+
+Histogram::Histogram() : max(0)
+{
+}
+
+int32 Histogram::getBucket(int64 value)
+{
+    if (value < SubBucketCount) {
+        return FMath::Max<int64>(value, 0);
+    }
+    // the sub bucket is given by the three bits below the highest set bit
+    int32 exponent = FMath::FloorLog2_64(uint64(value));
+    if (exponent > MaxExponent) {
+        return BucketCount - 1;
+    }
+    int32 shift = exponent - 3;
+    return SubBucketCount + shift * SubBucketCount + int32(value >> shift) - SubBucketCount;
+}
+
+int64 Histogram::getUpperBound(int32 bucket)
+{
+    if (bucket < SubBucketCount) {
+        return bucket;
+    }
+    int32 shift = (bucket - SubBucketCount) / SubBucketCount;
+    int32 subBucket = (bucket - SubBucketCount) % SubBucketCount;
+    return (int64(SubBucketCount + subBucket + 1) << shift) - 1;
+}
+
+void Histogram::add(int64 value)
+{
+    buckets[getBucket(value)].Increment();
+    count.Increment();
+    sum.Add(value);
+
+    int64 current = max;
+    while (value > current) {
+        int64 previous = FPlatformAtomics::InterlockedCompareExchange(&max, value, current);
+        if (previous == current) {
+            break;
+        }
+        current = previous;
+    }
+}
+
+void Histogram::reset()
+{
+    for (auto& bucket : buckets) {
+        bucket.Reset();
+    }
+    count.Reset();
+    sum.Reset();
+    max = 0;
+}
+
+int64 Histogram::getCount() const
+{
+    return count.GetValue();
+}
+
+double Histogram::getMean() const
+{
+    int64 samples = count.GetValue();
+    return samples > 0 ? double(sum.GetValue()) / samples : 0;
+}
+
+int64 Histogram::getMax() const
+{
+    return max;
+}
+
+int64 Histogram::getPercentile(float percentile) const
+{
+    int64 samples = count.GetValue();
+    if (samples == 0) {
+        return 0;
+    }
+    int64 rank = FMath::Max<int64>(1, FMath::CeilToInt(percentile * samples));
+    int64 seen = 0;
+    for (int32 i = 0; i < BucketCount; i++) {
+        seen += buckets[i].GetValue();
+        if (seen >= rank) {
+            return FMath::Min(getUpperBound(i), getMax());
+        }
+    }
+    return getMax();
+}
+
+void MoveRequestLatency::reset()
+{
+    moveRequests.Reset();
+    moveRequestRetries.Reset();
+    pathReadyMicrosCacheHit.reset();
+    pathReadyMicrosCacheMiss.reset();
+    firstMoveMicrosCacheHit.reset();
+    firstMoveMicrosCacheMiss.reset();
+}
+
+void Counters::reset()
+{
+    waypointCacheLookups.Reset();
+    waypointCacheHits.Reset();
+    flowMapCacheHits.Reset();
+    flowMapCacheMisses.Reset();
+    flowMapCacheEvictions.Reset();
+    diskCacheHits.Reset();
+    diskCacheMisses.Reset();
+    syncFlowMapSolves.Reset();
+    asyncFlowMapSolves.Reset();
+    flowMapTasksQueued.Reset();
+    flowMapTasksMerged.Reset();
+    flowMapTasksDropped.Reset();
+    flowMapTasksEvicted.Reset();
+    flowMapTasksPreempted.Reset();
+    flowMapTasksCompleted.Reset();
+    flowMapTasksAbandoned.Reset();
+    tileBuilds.Reset();
+    portalSearches.Reset();
+    portalNodesExpanded.Reset();
+    mapUpdates.Reset();
+    invalidatedRoutes.Reset();
+    waypointCacheBytes.Reset();
+    flowMapCacheBytes.Reset();
+    diskCacheBytes.Reset();
+    flowMapPoolBytes.Reset();
+    tilePoolBytes.Reset();
+    flowMapBuffersReused.Reset();
+    portalNodesPerSearch.reset();
+    flowMapTaskLatencyMicros.reset();
+    flowMapQueueDepth.reset();
+    invalidatedRoutesPerMapUpdate.reset();
+    evictedFlowMapsPerMapUpdate.reset();
+    requestLatency.reset();
+}
+
+void Counters::forEach(TFunctionRef<void(const TCHAR*, int64)> visitor) const
+{
+    visitor(TEXT("waypointCacheLookups"), waypointCacheLookups.GetValue());
+    visitor(TEXT("waypointCacheHits"), waypointCacheHits.GetValue());
+    visitor(TEXT("flowMapCacheHits"), flowMapCacheHits.GetValue());
+    visitor(TEXT("flowMapCacheMisses"), flowMapCacheMisses.GetValue());
+    visitor(TEXT("flowMapCacheEvictions"), flowMapCacheEvictions.GetValue());
+    visitor(TEXT("diskCacheHits"), diskCacheHits.GetValue());
+    visitor(TEXT("diskCacheMisses"), diskCacheMisses.GetValue());
+    visitor(TEXT("syncFlowMapSolves"), syncFlowMapSolves.GetValue());
+    visitor(TEXT("asyncFlowMapSolves"), asyncFlowMapSolves.GetValue());
+    visitor(TEXT("flowMapTasksQueued"), flowMapTasksQueued.GetValue());
+    visitor(TEXT("flowMapTasksMerged"), flowMapTasksMerged.GetValue());
+    visitor(TEXT("flowMapTasksDropped"), flowMapTasksDropped.GetValue());
+    visitor(TEXT("flowMapTasksEvicted"), flowMapTasksEvicted.GetValue());
+    visitor(TEXT("flowMapTasksPreempted"), flowMapTasksPreempted.GetValue());
+    visitor(TEXT("flowMapTasksCompleted"), flowMapTasksCompleted.GetValue());
+    visitor(TEXT("flowMapTasksAbandoned"), flowMapTasksAbandoned.GetValue());
+    visitor(TEXT("tileBuilds"), tileBuilds.GetValue());
+    visitor(TEXT("portalSearches"), portalSearches.GetValue());
+    visitor(TEXT("portalNodesExpanded"), portalNodesExpanded.GetValue());
+    visitor(TEXT("mapUpdates"), mapUpdates.GetValue());
+    visitor(TEXT("invalidatedRoutes"), invalidatedRoutes.GetValue());
+    visitor(TEXT("waypointCacheBytes"), waypointCacheBytes.GetValue());
+    visitor(TEXT("flowMapCacheBytes"), flowMapCacheBytes.GetValue());
+    visitor(TEXT("diskCacheBytes"), diskCacheBytes.GetValue());
+    visitor(TEXT("flowMapPoolBytes"), flowMapPoolBytes.GetValue());
+    visitor(TEXT("tilePoolBytes"), tilePoolBytes.GetValue());
+    visitor(TEXT("flowMapBuffersReused"), flowMapBuffersReused.GetValue());
+    visitor(TEXT("moveRequests"), requestLatency.moveRequests.GetValue());
+    visitor(TEXT("moveRequestRetries"), requestLatency.moveRequestRetries.GetValue());
+}
+
+static double getRate(int64 hits, int64 total)
+{
+    return total > 0 ? double(hits) / total : 0;
+}
+
+void Counters::forEachRate(TFunctionRef<void(const TCHAR*, double)> visitor) const
+{
+    visitor(TEXT("waypointCacheHitRate"), getRate(waypointCacheHits.GetValue(), waypointCacheLookups.GetValue()));
+    visitor(TEXT("flowMapCacheHitRate"), getRate(flowMapCacheHits.GetValue(), flowMapCacheHits.GetValue() + flowMapCacheMisses.GetValue()));
+    visitor(TEXT("diskCacheHitRate"), getRate(diskCacheHits.GetValue(), diskCacheHits.GetValue() + diskCacheMisses.GetValue()));
+}
+
+void Counters::forEachHistogram(TFunctionRef<void(const TCHAR*, const Histogram&)> visitor) const
+{
+    visitor(TEXT("portalNodesPerSearch"), portalNodesPerSearch);
+    visitor(TEXT("flowMapTaskLatencyMicros"), flowMapTaskLatencyMicros);
+    visitor(TEXT("flowMapQueueDepth"), flowMapQueueDepth);
+    visitor(TEXT("invalidatedRoutesPerMapUpdate"), invalidatedRoutesPerMapUpdate);
+    visitor(TEXT("evictedFlowMapsPerMapUpdate"), evictedFlowMapsPerMapUpdate);
+    visitor(TEXT("pathReadyMicrosCacheHit"), requestLatency.pathReadyMicrosCacheHit);
+    visitor(TEXT("pathReadyMicrosCacheMiss"), requestLatency.pathReadyMicrosCacheMiss);
+    visitor(TEXT("firstMoveMicrosCacheHit"), requestLatency.firstMoveMicrosCacheHit);
+    visitor(TEXT("firstMoveMicrosCacheMiss"), requestLatency.firstMoveMicrosCacheMiss);
+}
+
+void Counters::log() const
+{
+    forEach([](const TCHAR* name, int64 value) {
+        UE_LOG(LogExec, Display, TEXT("%-32s %lld"), name, value);
+    });
+    forEachRate([](const TCHAR* name, double rate) {
+        UE_LOG(LogExec, Display, TEXT("%-32s %.1f%%"), name, rate * 100);
+    });
+    forEachHistogram([](const TCHAR* name, const Histogram& histogram) {
+        UE_LOG(LogExec, Display, TEXT("%-32s count %lld, mean %.1f, p50 %lld, p95 %lld, p99 %lld, max %lld"), name, histogram.getCount(),
+            histogram.getMean(), histogram.getPercentile(0.5f), histogram.getPercentile(0.95f), histogram.getPercentile(0.99f), histogram.getMax());
+    });
+}
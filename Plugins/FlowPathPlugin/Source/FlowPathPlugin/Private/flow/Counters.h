@@ -0,0 +1,143 @@
+//
+// Event counters for the pathfinding hot paths.
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Stats/Stats.h"
+
+//For UE4 Profiler ~ Stat Group
+DECLARE_STATS_GROUP(TEXT("FlowPath"), STATGROUP_FlowPath, STATCAT_Advanced);
+
+// the stats that are updated from more than one file
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("FlowPath flowmap cache ~ hits"), STAT_FlowMapCacheHits, STATGROUP_FlowPath, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("FlowPath flowmap cache ~ evictions"), STAT_FlowMapCacheEvictions, STATGROUP_FlowPath, );
+
+namespace flow {
+
+    /**
+    * Distribution of a sample in logarithmic buckets that are split into eight linear steps each,
+    * so the percentiles are within 12.5% of the exact value. Samples can be added from any thread.
+    */
+    class Histogram {
+    public:
+        static const int32 SubBucketCount = 8;
+        // the samples above 2^MaxExponent all fall into the last bucket
+        static const int32 MaxExponent = 40;
+        static const int32 BucketCount = SubBucketCount * (MaxExponent - 1);
+
+    private:
+        // the samples below the sub bucket count have their own bucket, the samples <= 0 are in the first one
+        FThreadSafeCounter64 buckets[BucketCount];
+        FThreadSafeCounter64 count;
+        FThreadSafeCounter64 sum;
+        volatile int64 max;
+
+        static int32 getBucket(int64 value);
+
+        static int64 getUpperBound(int32 bucket);
+
+    public:
+        Histogram();
+
+        void add(int64 value);
+
+        void reset();
+
+        int64 getCount() const;
+
+        double getMean() const;
+
+        int64 getMax() const;
+
+        /** Returns the upper bound of the bucket that contains the percentile, which is between 0 and 1. */
+        int64 getPercentile(float percentile) const;
+    };
+
+    /** The move orders of the agents and their latency, see AFlowPathManager::GetRequestLatency. */
+    struct MoveRequestLatency {
+        FThreadSafeCounter64 moveRequests;
+        FThreadSafeCounter64 moveRequestRetries;
+        Histogram pathReadyMicrosCacheHit;
+        Histogram pathReadyMicrosCacheMiss;
+        Histogram firstMoveMicrosCacheHit;
+        Histogram firstMoveMicrosCacheMiss;
+
+        void reset();
+    };
+
+    /**
+    * Counts events on the hot paths. Unlike the stats the counters are always available, so they can be read by the replay tools in any build.
+    * All counters can be incremented from any thread.
+    */
+    struct Counters {
+        FThreadSafeCounter64 waypointCacheLookups;
+        FThreadSafeCounter64 waypointCacheHits;
+
+        FThreadSafeCounter64 flowMapCacheHits;
+        FThreadSafeCounter64 flowMapCacheMisses;
+        FThreadSafeCounter64 flowMapCacheEvictions;
+        FThreadSafeCounter64 diskCacheHits;
+        FThreadSafeCounter64 diskCacheMisses;
+
+        // flowmaps solved on the calling thread, which includes the cache misses and the uncached solves
+        FThreadSafeCounter64 syncFlowMapSolves;
+        // flowmaps solved by the generator threads
+        FThreadSafeCounter64 asyncFlowMapSolves;
+
+        FThreadSafeCounter64 flowMapTasksQueued;
+        FThreadSafeCounter64 flowMapTasksMerged;
+        FThreadSafeCounter64 flowMapTasksDropped;
+        // speculative tasks that were removed from a full queue to make room for an urgent request
+        FThreadSafeCounter64 flowMapTasksEvicted;
+        FThreadSafeCounter64 flowMapTasksPreempted;
+        FThreadSafeCounter64 flowMapTasksCompleted;
+        FThreadSafeCounter64 flowMapTasksAbandoned;
+        FThreadSafeCounter64 tileBuilds;
+
+        FThreadSafeCounter64 portalSearches;
+        FThreadSafeCounter64 portalNodesExpanded;
+
+        FThreadSafeCounter64 mapUpdates;
+        FThreadSafeCounter64 invalidatedRoutes;
+
+        // sampled by the manager, these are the current sizes and not running totals
+        FThreadSafeCounter64 waypointCacheBytes;
+        FThreadSafeCounter64 flowMapCacheBytes;
+        FThreadSafeCounter64 diskCacheBytes;
+        FThreadSafeCounter64 flowMapPoolBytes;
+        FThreadSafeCounter64 tilePoolBytes;
+
+        // flowmap buffers that were taken from the pool instead of being allocated
+        FThreadSafeCounter64 flowMapBuffersReused;
+
+        Histogram portalNodesPerSearch;
+        // from queuing the flowmap task until the game thread picks up the result
+        Histogram flowMapTaskLatencyMicros;
+        // sampled once per tick
+        Histogram flowMapQueueDepth;
+        Histogram invalidatedRoutesPerMapUpdate;
+        Histogram evictedFlowMapsPerMapUpdate;
+
+        // the move orders of the agents of all managers, each manager also keeps its own
+        MoveRequestLatency requestLatency;
+
+        void reset();
+
+        /** Calls the visitor with the name and value of every counter. */
+        void forEach(TFunctionRef<void(const TCHAR*, int64)> visitor) const;
+
+        /** Calls the visitor with the name and the hit rate between 0 and 1 of every cache. */
+        void forEachRate(TFunctionRef<void(const TCHAR*, double)> visitor) const;
+
+        /** Calls the visitor with the name and data of every histogram. */
+        void forEachHistogram(TFunctionRef<void(const TCHAR*, const Histogram&)> visitor) const;
+
+        /** Writes all counters, rates and histograms to the log. */
+        void log() const;
+    };
+
+    Counters& getCounters();
+}
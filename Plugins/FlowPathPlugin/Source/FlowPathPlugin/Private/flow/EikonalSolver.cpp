@@ -3,6 +3,7 @@
 //
 
 #include "EikonalSolver.h"
+#include "FlowMapPool.h"
 #include <list>
 
 using namespace flow;
@@ -122,8 +123,7 @@ TArray<EikonalCellValue> flow::CreateEikonalSurface(const TArray<uint8>& sourceD
     }
 
     // copy the result to the output
-    TArray<EikonalCellValue> output;
-    output.AddUninitialized(sourceData.Num());
+    TArray<EikonalCellValue> output = getFlowMapPool().acquire(sourceData.Num());
     for (int32 i = 0; i < length * length; i++) {
         output[i].cellValue = waveSurface[i].value;
         output[i].directionLookupIndex = waveSurface[i].parentDirection;
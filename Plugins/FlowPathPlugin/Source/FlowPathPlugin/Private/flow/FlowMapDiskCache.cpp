@@ -0,0 +1,212 @@
+//
+// Persistent second level cache for solved flowmaps.
+//
+
+#include "FlowMapDiskCache.h"
+#include "EikonalSolver.h"
+#include "FlowMapPool.h"
+#include "Counters.h"
+#include "HAL/PlatformFilemanager.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "Hash/CityHash.h"
+#include "Misc/Paths.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath disk cache ~ hits"), STAT_DiskCacheHits, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath disk cache ~ misses"), STAT_DiskCacheMisses, STATGROUP_FlowPath);
+
+using namespace flow;
+
+// "FPFC", followed by the version which has to be increased whenever the file format or the solver output changes
+const uint32 CacheMagic = 0x43465046;
+const uint32 CacheVersion = 1;
+const int64 CacheHeaderSize = 8;
+
+// key, checksum and cell count, followed by the direction and value of each cell
+const int64 RecordHeaderSize = 16;
+const int64 CellSize = 5;
+
+FlowMapDiskCache::FlowMapDiskCache() : maxFileSize(0) {
+}
+
+FlowMapDiskCache::~FlowMapDiskCache() {
+}
+
+FlowMapDiskCache::Key FlowMapDiskCache::createKey(const TArray<uint8>& sourceData, const TArray<FIntPoint>& targets)
+{
+    Key key;
+    uint64 dataHash = CityHash64(reinterpret_cast<const char*>(sourceData.GetData()), sourceData.Num());
+    key.hash = CityHash64WithSeed(reinterpret_cast<const char*>(targets.GetData()), targets.Num() * sizeof(FIntPoint), dataHash);
+    key.checksum = FCrc::MemCrc32(targets.GetData(), targets.Num() * sizeof(FIntPoint), FCrc::MemCrc32(sourceData.GetData(), sourceData.Num()));
+    key.cellCount = sourceData.Num();
+    return key;
+}
+
+bool FlowMapDiskCache::open(const FString& cacheFilename, int64 maxSize)
+{
+    FScopeLock scopeLock(&lock);
+    {
+        FScopeLock readScopeLock(&readHandleLock);
+        readHandles.Empty();
+    }
+    entries.Empty();
+    maxFileSize = maxSize;
+    filename = cacheFilename;
+
+    auto& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+    platformFile.CreateDirectoryTree(*FPaths::GetPath(filename));
+    file.Reset(platformFile.OpenWrite(*filename, true, true));
+    if (!file.IsValid()) {
+        return false;
+    }
+    if (file->Size() > 0 && readEntries()) {
+        return true;
+    }
+
+    // the file is new, from another version or damaged, so it is started from scratch
+    entries.Empty();
+    file.Reset(platformFile.OpenWrite(*filename, false, true));
+    if (!file.IsValid()) {
+        return false;
+    }
+    uint32 header[2] = { CacheMagic, CacheVersion };
+    return file->Write(reinterpret_cast<const uint8*>(header), CacheHeaderSize);
+}
+
+bool FlowMapDiskCache::readEntries()
+{
+    int64 fileSize = file->Size();
+    uint32 header[2];
+    if (fileSize < CacheHeaderSize || !file->Seek(0) || !file->Read(reinterpret_cast<uint8*>(header), CacheHeaderSize) || header[0] != CacheMagic || header[1] != CacheVersion) {
+        return false;
+    }
+
+    int64 position = CacheHeaderSize;
+    while (position + RecordHeaderSize <= fileSize) {
+        uint8 recordHeader[RecordHeaderSize];
+        if (!file->Seek(position) || !file->Read(recordHeader, RecordHeaderSize)) {
+            return false;
+        }
+        uint64 key;
+        uint32 checksum;
+        int32 cellCount;
+        FMemory::Memcpy(&key, recordHeader, 8);
+        FMemory::Memcpy(&checksum, recordHeader + 8, 4);
+        FMemory::Memcpy(&cellCount, recordHeader + 12, 4);
+        int64 recordEnd = position + RecordHeaderSize + cellCount * CellSize;
+        if (cellCount <= 0 || recordEnd > fileSize) {
+            // a record that was only partially written
+            return false;
+        }
+        entries.Add(key, { position + RecordHeaderSize, cellCount, checksum });
+        position = recordEnd;
+    }
+    return position == fileSize;
+}
+
+TUniquePtr<IFileHandle> FlowMapDiskCache::acquireReadHandle()
+{
+    {
+        FScopeLock scopeLock(&readHandleLock);
+        if (readHandles.Num() > 0) {
+            return readHandles.Pop(false);
+        }
+    }
+    // the records are only appended, so a separate handle sees every record that is in the index
+    return TUniquePtr<IFileHandle>(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*filename, true));
+}
+
+void FlowMapDiskCache::releaseReadHandle(TUniquePtr<IFileHandle>&& handle)
+{
+    FScopeLock scopeLock(&readHandleLock);
+    readHandles.Add(MoveTemp(handle));
+}
+
+bool FlowMapDiskCache::find(const Key& key, TArray<EikonalCellValue>& result)
+{
+    int64 offset;
+    {
+        FScopeLock scopeLock(&lock);
+        auto entry = entries.Find(key.hash);
+        if (entry == nullptr || entry->checksum != key.checksum || entry->cellCount != key.cellCount) {
+            INC_DWORD_STAT(STAT_DiskCacheMisses);
+            getCounters().diskCacheMisses.Increment();
+            return false;
+        }
+        offset = entry->offset;
+    }
+
+    // the file is read without the lock, so the hits of the generator threads are not serialized
+    auto handle = acquireReadHandle();
+    if (!handle.IsValid()) {
+        return false;
+    }
+    int32 cellCount = key.cellCount;
+    TArray<uint8> cellData;
+    cellData.AddUninitialized(cellCount * CellSize);
+    bool isRead = handle->Seek(offset) && handle->Read(cellData.GetData(), cellData.Num());
+    releaseReadHandle(MoveTemp(handle));
+    if (!isRead) {
+        return false;
+    }
+
+    INC_DWORD_STAT(STAT_DiskCacheHits);
+    getCounters().diskCacheHits.Increment();
+    result = getFlowMapPool().acquire(cellCount);
+    for (int32 i = 0; i < cellCount; i++) {
+        const uint8* cell = &cellData[i * CellSize];
+        result[i].directionLookupIndex = static_cast<int8>(cell[0]);
+        FMemory::Memcpy(&result[i].cellValue, cell + 1, 4);
+    }
+    return true;
+}
+
+void FlowMapDiskCache::add(const Key& key, const TArray<EikonalCellValue>& flowMap)
+{
+    if (flowMap.Num() != key.cellCount || flowMap.Num() == 0) {
+        return;
+    }
+    int32 cellCount = flowMap.Num();
+
+    TArray<uint8> record;
+    record.AddUninitialized(RecordHeaderSize + cellCount * CellSize);
+    FMemory::Memcpy(&record[0], &key.hash, 8);
+    FMemory::Memcpy(&record[8], &key.checksum, 4);
+    FMemory::Memcpy(&record[12], &cellCount, 4);
+    for (int32 i = 0; i < cellCount; i++) {
+        uint8* cell = &record[RecordHeaderSize + i * CellSize];
+        cell[0] = static_cast<uint8>(flowMap[i].directionLookupIndex);
+        FMemory::Memcpy(cell + 1, &flowMap[i].cellValue, 4);
+    }
+
+    FScopeLock scopeLock(&lock);
+    if (!file.IsValid() || entries.Contains(key.hash)) {
+        return;
+    }
+    int64 offset = file->Size();
+    if (offset + record.Num() > maxFileSize || !file->SeekFromEnd(0) || !file->Write(record.GetData(), record.Num())) {
+        return;
+    }
+    entries.Add(key.hash, { offset + RecordHeaderSize, cellCount, key.checksum });
+}
+
+int64 FlowMapDiskCache::getFileSize()
+{
+    FScopeLock scopeLock(&lock);
+    return file.IsValid() ? file->Size() : 0;
+}
+
+TArray<EikonalCellValue> flow::CreateCachedEikonalSurface(const TArray<uint8>& sourceData, const TArray<FIntPoint>& targetPoints, FlowMapDiskCache* cache)
+{
+    TArray<EikonalCellValue> result;
+    if (cache == nullptr) {
+        return CreateEikonalSurface(sourceData, targetPoints);
+    }
+    // the inputs are hashed once for the lookup and the store
+    FlowMapDiskCache::Key key = FlowMapDiskCache::createKey(sourceData, targetPoints);
+    if (cache->find(key, result)) {
+        return result;
+    }
+    result = CreateEikonalSurface(sourceData, targetPoints);
+    cache->add(key, result);
+    return result;
+}
@@ -0,0 +1,72 @@
+//
+// Persistent second level cache for solved flowmaps.
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowTile.h"
+
+class IFileHandle;
+
+namespace flow {
+
+    /**
+    * Stores solved flowmaps in an append-only file, keyed by a hash of the cost data and the targets they were solved for.
+    * A flowmap is a pure function of these inputs, so the cached results stay valid across sessions and map changes. Thread safe.
+    */
+    class FlowMapDiskCache {
+    public:
+        /** Identifies the inputs of a flowmap. The checksum is a second independent hash, so a collision of the hashes is detected. */
+        struct Key {
+            uint64 hash;
+            uint32 checksum;
+            int32 cellCount;
+        };
+
+    private:
+        struct Entry {
+            int64 offset;
+            int32 cellCount;
+            uint32 checksum;
+        };
+
+        // guards the index and the write handle, the cached flowmaps are read without it
+        FCriticalSection lock;
+        TUniquePtr<IFileHandle> file;
+        TMap<uint64, Entry> entries;
+        int64 maxFileSize;
+        FString filename;
+
+        // the read handles that are not in use, so the generator threads can read at the same time
+        FCriticalSection readHandleLock;
+        TArray<TUniquePtr<IFileHandle>> readHandles;
+
+        bool readEntries();
+
+        TUniquePtr<IFileHandle> acquireReadHandle();
+
+        void releaseReadHandle(TUniquePtr<IFileHandle>&& handle);
+
+    public:
+        FlowMapDiskCache();
+
+        ~FlowMapDiskCache();
+
+        /** Opens or creates the cache file. No more flowmaps are added once the file has reached the max size. */
+        bool open(const FString& filename, int64 maxFileSize);
+
+        /** Hashes the inputs of a flowmap, the key is used for both the lookup and the store of a solve. */
+        static Key createKey(const TArray<uint8>& sourceData, const TArray<FIntPoint>& targets);
+
+        bool find(const Key& key, TArray<EikonalCellValue>& result);
+
+        void add(const Key& key, const TArray<EikonalCellValue>& flowMap);
+
+        /** Returns the size of the cache file in bytes. */
+        int64 getFileSize();
+    };
+
+    /** Same as CreateEikonalSurface, but the flowmap is read from the disk cache if possible and added to it otherwise. The cache can be null. */
+    TArray<EikonalCellValue> CreateCachedEikonalSurface(const TArray<uint8>& sourceData, const TArray<FIntPoint>& targetPoints, FlowMapDiskCache* cache);
+}
@@ -0,0 +1,81 @@
+//
+// Recycles the buffers of the flowmaps.
+//
+
+#include "FlowMapPool.h"
+#include "Counters.h"
+
+using namespace flow;
+
+FlowMapPool& flow::getFlowMapPool()
+{
+    // never destroyed, because the tiles that release their flowmaps into it can outlive the static objects at shutdown
+    static FlowMapPool* pool = new FlowMapPool();
+    return *pool;
+}
+
+TArray<EikonalCellValue> FlowMapPool::acquire(int32 cellCount)
+{
+    TArray<EikonalCellValue> buffer;
+    {
+        FScopeLock scopeLock(&lock);
+        for (auto& sizeClass : sizeClasses) {
+            if (sizeClass.cellCount == cellCount && sizeClass.buffers.Num() > 0) {
+                buffer = sizeClass.buffers.Pop(false);
+                pooledSize -= buffer.GetAllocatedSize();
+                getCounters().flowMapBuffersReused.Increment();
+                return buffer;
+            }
+        }
+    }
+    // reserve first, growing an empty array would add a third of slack to every cached flowmap
+    buffer.Reserve(cellCount);
+    buffer.AddUninitialized(cellCount);
+    return buffer;
+}
+
+void FlowMapPool::release(TArray<EikonalCellValue>&& buffer)
+{
+    // the buffer is freed outside of the lock if the pool is full
+    TArray<EikonalCellValue> released = MoveTemp(buffer);
+    int32 cellCount = released.Num();
+    SIZE_T size = released.GetAllocatedSize();
+    if (cellCount == 0) {
+        return;
+    }
+
+    FScopeLock scopeLock(&lock);
+    if (pooledSize + size > maxPooledSize) {
+        return;
+    }
+    SizeClass* sizeClass = sizeClasses.FindByPredicate([cellCount](const SizeClass& entry) {
+        return entry.cellCount == cellCount;
+    });
+    if (sizeClass == nullptr) {
+        sizeClass = &sizeClasses[sizeClasses.AddDefaulted()];
+        sizeClass->cellCount = cellCount;
+    }
+    sizeClass->buffers.Add(MoveTemp(released));
+    pooledSize += size;
+}
+
+void FlowMapPool::setMaxPooledSize(SIZE_T size)
+{
+    TArray<TArray<EikonalCellValue>> freedBuffers;
+    {
+        FScopeLock scopeLock(&lock);
+        maxPooledSize = size;
+        for (auto& sizeClass : sizeClasses) {
+            while (pooledSize > maxPooledSize && sizeClass.buffers.Num() > 0) {
+                pooledSize -= sizeClass.buffers.Last().GetAllocatedSize();
+                freedBuffers.Add(sizeClass.buffers.Pop(false));
+            }
+        }
+    }
+}
+
+SIZE_T FlowMapPool::getPooledSize() const
+{
+    FScopeLock scopeLock(&lock);
+    return pooledSize;
+}
@@ -0,0 +1,54 @@
+//
+// Recycles the buffers of the flowmaps.
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowTile.h"
+
+namespace flow {
+
+    /**
+    * Keeps the buffers of removed flowmaps and hands them to the next flowmap of the same size, so editing tiles does not churn the heap.
+    * Every cell count is its own size class. There are only a few, because a flowmap covers one tile or the block of four tiles of a lookahead solve.
+    * The pool can be used from any thread and keeps at most the maximum pooled size, the buffers above it are freed.
+    */
+    class FlowMapPool {
+    private:
+        struct SizeClass {
+            int32 cellCount;
+            TArray<TArray<EikonalCellValue>> buffers;
+        };
+
+        mutable FCriticalSection lock;
+        TArray<SizeClass> sizeClasses;
+        SIZE_T pooledSize = 0;
+        SIZE_T maxPooledSize = 16 * 1024 * 1024;
+
+    public:
+        /** Returns a buffer with the given number of uninitialized cells and without slack. */
+        TArray<EikonalCellValue> acquire(int32 cellCount);
+
+        /** Takes the buffer back, it is empty afterwards. */
+        void release(TArray<EikonalCellValue>&& buffer);
+
+        /** Releases the buffers of all flowmaps and empties the map. */
+        template<typename KeyType>
+        void releaseAll(TMap<KeyType, TArray<EikonalCellValue>>& flowMaps)
+        {
+            for (auto& entry : flowMaps) {
+                release(MoveTemp(entry.Value));
+            }
+            flowMaps.Empty();
+        }
+
+        /** Frees the pooled buffers above the new maximum. */
+        void setMaxPooledSize(SIZE_T size);
+
+        /** Returns the bytes of the buffers that wait in the pool. */
+        SIZE_T getPooledSize() const;
+    };
+
+    FlowMapPool& getFlowMapPool();
+}
@@ -4,11 +4,25 @@
 
 #include "FlowPath.h"
 #include "flow/EikonalSolver.h"
+#include "FlowMapPool.h"
+#include "Counters.h"
+#include "ChromeTrace.h"
+#include "Async/ParallelFor.h"
 #include <iostream>
 
 using namespace std;
 using namespace flow;
 
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath waypoint cache ~ lookups"), STAT_WaypointCacheLookups, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath waypoint cache ~ hits"), STAT_WaypointCacheHits, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath portal search ~ searches"), STAT_PortalSearches, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath portal search ~ expanded nodes"), STAT_PortalNodesExpanded, STATGROUP_FlowPath);
+
+// "FPNB", followed by the version which has to be increased whenever the baked format changes
+const uint32 BakeMagic = 0x424E5046;
+const uint32 BakeVersion = 1;
+const uint32 BakeFlagFlowMaps = 1 << 0;
+
 FlowPath::FlowPath(int32 tileLength) : tileLength(tileLength) {
     int32 size = tileLength * tileLength;
     emptyTileData.AddUninitialized(size);
@@ -29,16 +43,55 @@ bool flow::TilePoint::operator!=(const TilePoint & other) const
     return tileLocation != other.tileLocation || pointInTile != other.pointInTile;
 }
 
+bool flow::TilePagingBatch::isEmpty() const
+{
+    return loadedTiles.Num() == 0 && savedTiles.Num() == 0;
+}
+
 bool FlowPath::updateMapTile(int32 tileX, int32 tileY, const TArray<uint8> &tileData) {
+    return replaceTileData(FIntPoint(tileX, tileY), tileData) != CellUpdateResult::Failed;
+}
+
+CellUpdateResult flow::FlowPath::replaceTileData(const FIntPoint& coord, const TArray<uint8>& tileData)
+{
+    if (!isValidTileData(tileData)) {
+        return CellUpdateResult::Failed;
+    }
+
+    auto existingTile = getTile(coord);
+    if (existingTile == nullptr || !ensureResident(existingTile)) {
+        rebuildTile(coord, tileData);
+        return CellUpdateResult::TileRebuilt;
+    }
+    TArray<uint8> scratch;
+    auto& existingData = existingTile->getData(scratch);
+    TArray<int32> changedCells;
+    for (int32 i = 0; i < tileData.Num(); i++) {
+        if (existingData[i] != tileData[i]) {
+            changedCells.Add(i);
+        }
+    }
+    return applyTileData(existingTile, tileData, changedCells);
+}
+
+bool flow::FlowPath::isValidTileData(const TArray<uint8>& tileData) const
+{
     if (tileData.Num() != tileLength * tileLength) {
         return false;
     }
-    bool isEmpty = true;
-    bool isBlocked = true;
     for (int32 i = 0; i < tileData.Num(); i++) {
         if (tileData[i] == 0) {
             return false;
         }
+    }
+    return true;
+}
+
+FlowTile* flow::FlowPath::createTile(const FIntPoint& coord, const TArray<uint8>& tileData)
+{
+    bool isEmpty = true;
+    bool isBlocked = true;
+    for (int32 i = 0; i < tileData.Num(); i++) {
         if (tileData[i] != EMPTY) {
             isEmpty = false;
         }
@@ -47,7 +100,6 @@ bool FlowPath::updateMapTile(int32 tileX, int32 tileY, const TArray<uint8> &tile
         }
     }
 
-    FIntPoint coord(tileX, tileY);
     FlowTile *tile;
     if (isEmpty) {
         tile = new FlowTile(&emptyTileData, tileLength, coord);
@@ -58,20 +110,583 @@ bool FlowPath::updateMapTile(int32 tileX, int32 tileY, const TArray<uint8> &tile
     else {
         tile = new FlowTile(tileData, tileLength, coord);
     }
-    auto existingTile = tileMap.Find(coord);
+    tile->setDiskCache(diskCache.Get());
+    return tile;
+}
+
+void flow::FlowPath::rebuildTile(const FIntPoint& coord, const TArray<uint8>& tileData)
+{
+    publishTile(TUniquePtr<FlowTile>(createTile(coord, tileData)));
+}
+
+void flow::FlowPath::publishTile(TUniquePtr<FlowTile> tile)
+{
+    FIntPoint coord = tile->getCoordinates();
+    auto existingTile = tileGrid.find(coord);
     if (existingTile != nullptr) {
-        clearTileFromWaypointCache(**existingTile);
-        (*existingTile)->removeConnectedPortals();
+        if (isBulkUpdateOpen) {
+            isWaypointCacheDirty = true;
+        }
+        else {
+            clearTileFromWaypointCache(*existingTile);
+        }
+        existingTile->removeConnectedPortals();
+        INC_DWORD_STAT_BY(STAT_FlowMapCacheEvictions, existingTile->getFlowMapCount());
+        getCounters().flowMapCacheEvictions.Add(existingTile->getFlowMapCount());
         for (auto& neighbor : neighbors) {
-            auto neighborTile = tileMap.Find(coord + neighbor);
+            auto neighborTile = tileGrid.find(coord + neighbor);
             if (neighborTile != nullptr) {
-                (*neighborTile)->invalidatedTile(**existingTile);
+                neighborTile->invalidatedTile(*existingTile);
+            }
+        }
+    }
+    // the replaced tile is destroyed with the returned pointer
+    tileGrid.add(MoveTemp(tile));
+    markTileChanged(coord);
+    if (isBulkUpdateOpen) {
+        unconnectedTiles.Add(coord);
+    }
+    else {
+        updatePortals(coord);
+    }
+}
+
+TArray<CellUpdateResult> flow::FlowPath::replaceTilesData(const TArray<FIntPoint>& tileCoordinates, const TArray<TArray<uint8>>& tilesData)
+{
+    check(tileCoordinates.Num() == tilesData.Num());
+
+    // existing tiles are diffed and updated in place, the missing ones are constructed in parallel
+    TArray<CellUpdateResult> results;
+    results.Init(CellUpdateResult::Failed, tileCoordinates.Num());
+    TMap<FIntPoint, int32> newTileIndices;
+    TArray<int32> newTiles;
+    TArray<int32> repeatedTiles;
+    for (int32 i = 0; i < tileCoordinates.Num(); i++) {
+        if (getTile(tileCoordinates[i]) != nullptr) {
+            results[i] = replaceTileData(tileCoordinates[i], tilesData[i]);
+        }
+        else if (newTileIndices.Contains(tileCoordinates[i])) {
+            repeatedTiles.Add(i);
+        }
+        else if (isValidTileData(tilesData[i])) {
+            newTileIndices.Add(tileCoordinates[i], newTiles.Num());
+            newTiles.Add(i);
+        }
+    }
+
+    TArray<FlowTile*> builtTiles;
+    builtTiles.SetNumZeroed(newTiles.Num());
+    ParallelFor(newTiles.Num(), [this, &builtTiles, &newTiles, &tileCoordinates, &tilesData](int32 i) {
+        builtTiles[i] = createTile(tileCoordinates[newTiles[i]], tilesData[newTiles[i]]);
+    });
+
+    // connect the new tiles with each other, every pass only touches edges that do not share a tile
+    const FIntPoint passDirections[4] = { FIntPoint(1, 0), FIntPoint(1, 0), FIntPoint(0, 1), FIntPoint(0, 1) };
+    for (int32 pass = 0; pass < 4; pass++) {
+        FIntPoint direction = passDirections[pass];
+        int32 parity = pass % 2;
+        ParallelFor(builtTiles.Num(), [&builtTiles, &newTileIndices, direction, parity](int32 i) {
+            auto tile = builtTiles[i];
+            FIntPoint coord = tile->getCoordinates();
+            int32 axis = direction.X != 0 ? coord.X : coord.Y;
+            if ((axis & 1) != parity) {
+                return;
+            }
+            auto neighborIndex = newTileIndices.Find(coord + direction);
+            if (neighborIndex != nullptr) {
+                tile->connectOverlappingPortals(*builtTiles[*neighborIndex], direction.X != 0 ? Orientation::RIGHT : Orientation::BOTTOM);
+            }
+        });
+    }
+
+    // publish the tiles and connect them with the existing neighbors
+    for (int32 i = 0; i < builtTiles.Num(); i++) {
+        auto tile = builtTiles[i];
+        FIntPoint coord = tile->getCoordinates();
+        tileGrid.add(TUniquePtr<FlowTile>(tile));
+        markTileChanged(coord);
+        results[newTiles[i]] = CellUpdateResult::TileRebuilt;
+    }
+    const Orientation sides[4] = { Orientation::LEFT, Orientation::BOTTOM, Orientation::RIGHT, Orientation::TOP };
+    const FIntPoint sideOffsets[4] = { FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(1, 0), FIntPoint(0, -1) };
+    for (auto tile : builtTiles) {
+        for (int32 side = 0; side < 4; side++) {
+            FIntPoint neighborCoord = tile->getCoordinates() + sideOffsets[side];
+            auto neighborTile = getTile(neighborCoord);
+            if (neighborTile != nullptr && !newTileIndices.Contains(neighborCoord)) {
+                tile->connectOverlappingPortals(*neighborTile, sides[side]);
+            }
+        }
+    }
+
+    for (auto i : repeatedTiles) {
+        results[i] = replaceTileData(tileCoordinates[i], tilesData[i]);
+    }
+    return results;
+}
+
+CellUpdateResult flow::FlowPath::applyTileData(FlowTile* tile, const TArray<uint8>& newData, const TArray<int32>& changedCells)
+{
+    if (changedCells.Num() == 0) {
+        return CellUpdateResult::Unchanged;
+    }
+
+    bool isEmpty = true;
+    bool isBlocked = true;
+    for (auto value : newData) {
+        isEmpty &= value == EMPTY;
+        isBlocked &= value == BLOCKED;
+    }
+    TArray<uint8>* fixedData = isEmpty ? &emptyTileData : (isBlocked ? &fullTileData : nullptr);
+
+    FIntPoint coord = tile->getCoordinates();
+    markTileChanged(coord);
+    bool connectionsChanged;
+    if (!tile->updateCells(newData, fixedData, changedCells, connectionsChanged)) {
+        rebuildTile(coord, newData);
+        return CellUpdateResult::TileRebuilt;
+    }
+
+    if (connectionsChanged) {
+        // cached routes through the tile might use a connection that does not exist anymore
+        if (isBulkUpdateOpen) {
+            isWaypointCacheDirty = true;
+        }
+        else {
+            clearTileFromWaypointCache(*tile);
+        }
+    }
+    for (int32 y = -1; y <= 1; y++) {
+        for (int32 x = -1; x <= 1; x++) {
+            auto neighborTile = getTile(coord + FIntPoint(x, y));
+            if (neighborTile != nullptr && neighborTile != tile) {
+                neighborTile->invalidateLookaheadFlowMaps(coord);
+            }
+        }
+    }
+    return connectionsChanged ? CellUpdateResult::ConnectionsUpdated : CellUpdateResult::InteriorUpdated;
+}
+
+CellUpdateResult flow::FlowPath::updateMapCells(const FIntPoint& tileCoordinates, const FIntPoint& regionOrigin, const FIntPoint& regionSize, const TArray<uint8>& regionData)
+{
+    auto tile = getTile(tileCoordinates);
+    if (tile == nullptr || regionData.Num() != regionSize.X * regionSize.Y || !ensureResident(tile)) {
+        return CellUpdateResult::Failed;
+    }
+
+    // apply the overlapping part of the region and remember which cells have changed
+    FIntPoint tileOrigin = tileCoordinates * tileLength;
+    int32 startX = FMath::Max(regionOrigin.X, tileOrigin.X);
+    int32 startY = FMath::Max(regionOrigin.Y, tileOrigin.Y);
+    int32 endX = FMath::Min(regionOrigin.X + regionSize.X, tileOrigin.X + tileLength);
+    int32 endY = FMath::Min(regionOrigin.Y + regionSize.Y, tileOrigin.Y + tileLength);
+    TArray<uint8> newData;
+    tile->copyData(newData);
+    TArray<int32> changedCells;
+    for (int32 y = startY; y < endY; y++) {
+        for (int32 x = startX; x < endX; x++) {
+            uint8 value = regionData[(x - regionOrigin.X) + (y - regionOrigin.Y) * regionSize.X];
+            if (value == 0) {
+                return CellUpdateResult::Failed;
+            }
+            int32 index = (x - tileOrigin.X) + (y - tileOrigin.Y) * tileLength;
+            if (newData[index] != value) {
+                newData[index] = value;
+                changedCells.Add(index);
+            }
+        }
+    }
+    return applyTileData(tile, newData, changedCells);
+}
+
+bool flow::FlowPath::prepareMapCellsUpdate(const FIntPoint& regionOrigin, const FIntPoint& regionSize, const TArray<uint8>& regionData)
+{
+    if (regionSize.X <= 0 || regionSize.Y <= 0 || regionData.Num() != regionSize.X * regionSize.Y) {
+        return false;
+    }
+    for (uint8 value : regionData) {
+        if (value == 0) {
+            return false;
+        }
+    }
+    FIntPoint startTile = toTilePoint(regionOrigin).tileLocation;
+    FIntPoint endTile = toTilePoint(regionOrigin + regionSize - FIntPoint(1, 1)).tileLocation;
+    for (int32 y = startTile.Y; y <= endTile.Y; y++) {
+        for (int32 x = startTile.X; x <= endTile.X; x++) {
+            auto tile = getTile(FIntPoint(x, y));
+            if (tile == nullptr || !ensureResident(tile)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void flow::FlowPath::beginBulkUpdate()
+{
+    isBulkUpdateOpen = true;
+}
+
+void flow::FlowPath::endBulkUpdate()
+{
+    if (!isBulkUpdateOpen) {
+        return;
+    }
+    isBulkUpdateOpen = false;
+    for (auto& coord : unconnectedTiles) {
+        updatePortals(coord);
+    }
+    unconnectedTiles.Empty();
+    if (isWaypointCacheDirty) {
+        // clearing the whole cache once is cheaper than following the cached chains of every changed tile
+        waypointCache.Empty();
+        isWaypointCacheDirty = false;
+    }
+}
+
+void flow::FlowPath::enablePaging(const FString& storeDirectory)
+{
+    tileStore = MakeUnique<TileStore>(storeDirectory);
+    // the store could contain the tiles of an older map
+    tileStore->clear();
+    storedTiles.Empty();
+    residentTiles.Empty();
+    pagingTiles.Empty();
+    outdatedPagingTiles.Empty();
+    for (auto& tile : tileGrid.getTiles()) {
+        residentTiles.Add(tile->getCoordinates(), currentTick);
+    }
+}
+
+bool flow::FlowPath::isPagingEnabled() const
+{
+    return tileStore.IsValid();
+}
+
+void flow::FlowPath::markTileChanged(const FIntPoint& coord)
+{
+    if (!tileStore.IsValid()) {
+        return;
+    }
+    storedTiles.Remove(coord);
+    residentTiles.Add(coord, currentTick);
+    if (pagingTiles.Contains(coord)) {
+        outdatedPagingTiles.Add(coord);
+    }
+}
+
+void flow::FlowPath::planResidentTiles(const TSet<FIntPoint>& usedTiles, const TSet<FIntPoint>& requiredTiles, int32 maxResidentTiles, TilePagingBatch& requiredBatch, TilePagingBatch& prefetchBatch)
+{
+    if (!tileStore.IsValid()) {
+        return;
+    }
+    currentTick++;
+    for (auto& coord : usedTiles) {
+        auto tile = getTile(coord);
+        if (tile == nullptr) {
+            continue;
+        }
+        if (tile->isResident()) {
+            residentTiles.Add(coord, currentTick);
+        }
+        else if (requiredTiles.Contains(coord)) {
+            // the required tiles are loaded right away, even if their prefetch has not finished yet
+            addTileLoad(coord, requiredBatch);
+        }
+        else if (!pagingTiles.Contains(coord)) {
+            addTileLoad(coord, prefetchBatch);
+        }
+    }
+
+    // the tiles that are saved right now are paged out once their batch is applied
+    int32 residentCount = residentTiles.Num();
+    for (auto& entry : pagingTiles) {
+        if (residentTiles.Contains(entry.Key)) {
+            residentCount--;
+        }
+    }
+    if (residentCount <= maxResidentTiles) {
+        return;
+    }
+
+    // page out the least recently used tiles, the used ones stay resident even if there are more than allowed
+    TArray<TPair<uint32, FIntPoint>> candidates;
+    for (auto& entry : residentTiles) {
+        if (entry.Value != currentTick && !pagingTiles.Contains(entry.Key)) {
+            candidates.Emplace(entry.Value, entry.Key);
+        }
+    }
+    candidates.Sort([](const TPair<uint32, FIntPoint>& A, const TPair<uint32, FIntPoint>& B) { return A.Key < B.Key; });
+    for (int32 i = 0; i < candidates.Num() && residentCount > maxResidentTiles; i++) {
+        FIntPoint coord = candidates[i].Value;
+        auto tile = getTile(coord);
+        residentCount--;
+        if (tile == nullptr || !tile->hasOwnData() || storedTiles.Contains(coord)) {
+            pageOutTile(coord);
+            continue;
+        }
+        // the tile stays readable until its data is saved
+        pagingTiles.Add(coord, 1);
+        prefetchBatch.savedTiles.Add(coord);
+        tile->copyData(prefetchBatch.savedData[prefetchBatch.savedData.AddDefaulted()]);
+    }
+}
+
+void flow::FlowPath::planTileLoads(const TSet<FIntPoint>& tiles, TilePagingBatch& batch)
+{
+    if (!tileStore.IsValid()) {
+        return;
+    }
+    for (auto& coord : tiles) {
+        auto tile = getTile(coord);
+        if (tile != nullptr && !tile->isResident()) {
+            addTileLoad(coord, batch);
+        }
+    }
+}
+
+void flow::FlowPath::addTileLoad(const FIntPoint& coord, TilePagingBatch& batch)
+{
+    // a tile that is loaded by several batches is paged in by the first one that is applied
+    pagingTiles.FindOrAdd(coord)++;
+    batch.loadedTiles.Add(coord);
+}
+
+bool flow::FlowPath::releasePagingTile(const FIntPoint& coord)
+{
+    int32* count = pagingTiles.Find(coord);
+    if (count != nullptr && --(*count) > 0) {
+        return false;
+    }
+    pagingTiles.Remove(coord);
+    outdatedPagingTiles.Remove(coord);
+    return true;
+}
+
+void flow::FlowPath::transferTiles(TilePagingBatch& batch) const
+{
+    check(tileStore.IsValid());
+    batch.loadedData.SetNum(batch.loadedTiles.Num());
+    for (int32 i = 0; i < batch.loadedTiles.Num(); i++) {
+        if (!tileStore->load(batch.loadedTiles[i], batch.loadedData[i])) {
+            batch.loadedData[i].Empty();
+        }
+    }
+    batch.isSaved.Init(false, batch.savedTiles.Num());
+    for (int32 i = 0; i < batch.savedTiles.Num(); i++) {
+        batch.isSaved[i] = tileStore->save(batch.savedTiles[i], batch.savedData[i]);
+    }
+}
+
+void flow::FlowPath::applyTilePaging(TilePagingBatch& batch)
+{
+    for (int32 i = 0; i < batch.loadedTiles.Num(); i++) {
+        FIntPoint coord = batch.loadedTiles[i];
+        releasePagingTile(coord);
+        auto tile = getTile(coord);
+        // a map update can have paged in the tile in the meantime
+        if (tile == nullptr || tile->isResident()) {
+            continue;
+        }
+        if (batch.loadedData[i].Num() != tileLength * tileLength) {
+            UE_LOG(LogExec, Warning, TEXT("Unable to page in flow path tile (%d, %d)."), coord.X, coord.Y);
+            continue;
+        }
+        tile->pageIn(MoveTemp(batch.loadedData[i]));
+        residentTiles.Add(coord, currentTick);
+    }
+    for (int32 i = 0; i < batch.savedTiles.Num(); i++) {
+        FIntPoint coord = batch.savedTiles[i];
+        bool isOutdated = outdatedPagingTiles.Contains(coord);
+        releasePagingTile(coord);
+        if (!batch.isSaved[i]) {
+            UE_LOG(LogExec, Warning, TEXT("Unable to page out flow path tile (%d, %d)."), coord.X, coord.Y);
+            continue;
+        }
+        if (isOutdated || getTile(coord) == nullptr) {
+            continue;
+        }
+        storedTiles.Add(coord);
+        // the tile stays resident if it was used again while it was saved
+        if (residentTiles.FindRef(coord) != currentTick) {
+            pageOutTile(coord);
+        }
+    }
+}
+
+void flow::FlowPath::pageOutTile(const FIntPoint& coord)
+{
+    auto tile = getTile(coord);
+    if (tile != nullptr) {
+        TArray<uint8> data;
+        tile->pageOut(data);
+    }
+    residentTiles.Remove(coord);
+}
+
+bool flow::FlowPath::ensureResident(FlowTile* tile)
+{
+    if (tile->isResident()) {
+        return true;
+    }
+    TArray<uint8> data;
+    FIntPoint coord = tile->getCoordinates();
+    if (!tileStore.IsValid() || !tileStore->load(coord, data) || data.Num() != tileLength * tileLength) {
+        UE_LOG(LogExec, Warning, TEXT("Unable to page in flow path tile (%d, %d)."), coord.X, coord.Y);
+        return false;
+    }
+    tile->pageIn(MoveTemp(data));
+    residentTiles.Add(coord, currentTick);
+    return true;
+}
+
+int32 flow::FlowPath::getResidentTileCount() const
+{
+    return tileStore.IsValid() ? residentTiles.Num() : tileGrid.num();
+}
+
+SIZE_T flow::FlowPath::getWaypointCacheSize() const
+{
+    SIZE_T size = waypointCache.GetAllocatedSize();
+    for (auto& entry : waypointCache) {
+        size += entry.Value.GetAllocatedSize();
+    }
+    return size;
+}
+
+SIZE_T flow::FlowPath::getFlowMapCacheSize() const
+{
+    SIZE_T size = 0;
+    for (auto& tile : tileGrid.getTiles()) {
+        size += tile->getFlowMapsSize();
+    }
+    return size;
+}
+
+bool flow::FlowPath::enableDiskCache(const FString& filename, int64 maxFileSize)
+{
+    auto cache = MakeUnique<FlowMapDiskCache>();
+    if (!cache->open(filename, maxFileSize)) {
+        UE_LOG(LogExec, Warning, TEXT("Unable to open the flowmap cache %s."), *filename);
+        return false;
+    }
+    diskCache = MoveTemp(cache);
+    for (auto& tile : tileGrid.getTiles()) {
+        tile->setDiskCache(diskCache.Get());
+    }
+    return true;
+}
+
+FlowMapDiskCache* flow::FlowPath::getDiskCache() const
+{
+    return diskCache.Get();
+}
+
+bool flow::FlowPath::writeBake(FArchive& ar, bool includeFlowMaps)
+{
+    if (isBulkUpdateOpen) {
+        return false;
+    }
+    TArray<FlowTile*> tiles;
+    TMap<const Portal*, BakedPortalIndex> portalIndices;
+    for (auto& entry : tileGrid.getTiles()) {
+        auto tile = entry.Get();
+        if (!ensureResident(tile)) {
+            return false;
+        }
+        auto& portals = tile->getPortals();
+        for (int32 i = 0; i < portals.Num(); i++) {
+            portalIndices.Add(&portals[i], BakedPortalIndex(tiles.Num(), i));
+        }
+        tiles.Add(tile);
+    }
+    auto indexOf = [&portalIndices](const Portal* portal) {
+        auto index = portalIndices.Find(portal);
+        return index != nullptr ? *index : BakedPortalIndex(INDEX_NONE, INDEX_NONE);
+    };
+
+    uint32 magic = BakeMagic;
+    uint32 version = BakeVersion;
+    uint32 flags = includeFlowMaps ? BakeFlagFlowMaps : 0;
+    int32 length = tileLength;
+    int32 tileCount = tiles.Num();
+    ar << magic << version << flags << length << tileCount;
+    for (auto tile : tiles) {
+        FIntPoint coord = tile->getCoordinates();
+        ar << coord;
+        tile->writeBake(ar, &emptyTileData, &fullTileData);
+    }
+    for (auto tile : tiles) {
+        tile->writeBakedConnections(ar, indexOf);
+    }
+    if (includeFlowMaps) {
+        for (auto tile : tiles) {
+            tile->writeBakedFlowMaps(ar, indexOf);
+        }
+    }
+    return !ar.IsError();
+}
+
+bool flow::FlowPath::readBake(FArchive& ar)
+{
+    uint32 magic = 0;
+    uint32 version = 0;
+    uint32 flags = 0;
+    int32 length = 0;
+    int32 tileCount = 0;
+    ar << magic << version << flags << length << tileCount;
+    if (ar.IsError() || magic != BakeMagic || version != BakeVersion || length != tileLength || tileCount < 0) {
+        return false;
+    }
+
+    // everything is read into new tiles first, so invalid data does not leave a half loaded map
+    TArray<TUniquePtr<FlowTile>> tiles;
+    TSet<FIntPoint> coords;
+    for (int32 i = 0; i < tileCount; i++) {
+        FIntPoint coord;
+        ar << coord;
+        bool isDuplicate;
+        coords.Add(coord, &isDuplicate);
+        if (ar.IsError() || isDuplicate) {
+            return false;
+        }
+        tiles.Emplace(new FlowTile(ar, &emptyTileData, &fullTileData, tileLength, coord));
+        if (ar.IsError()) {
+            return false;
+        }
+        tiles.Last()->setDiskCache(diskCache.Get());
+    }
+    auto findPortal = [&tiles](const BakedPortalIndex& index) -> Portal* {
+        if (!tiles.IsValidIndex(index.Key) || !tiles[index.Key]->getPortals().IsValidIndex(index.Value)) {
+            return nullptr;
+        }
+        return const_cast<Portal*>(&tiles[index.Key]->getPortals()[index.Value]);
+    };
+    for (auto& tile : tiles) {
+        if (!tile->readBakedConnections(ar, findPortal)) {
+            return false;
+        }
+    }
+    if ((flags & BakeFlagFlowMaps) != 0) {
+        for (auto& tile : tiles) {
+            if (!tile->readBakedFlowMaps(ar, findPortal)) {
+                return false;
             }
         }
-        tileMap.Remove(coord);
     }
-    tileMap.Add(coord, TUniquePtr<FlowTile>(tile));
-    updatePortals(coord);
+
+    tileGrid.empty();
+    waypointCache.Empty();
+    unconnectedTiles.Empty();
+    residentTiles.Empty();
+    storedTiles.Empty();
+    pagingTiles.Empty();
+    outdatedPagingTiles.Empty();
+    for (auto& tile : tiles) {
+        FIntPoint coord = tile->getCoordinates();
+        tileGrid.add(MoveTemp(tile));
+        markTileChanged(coord);
+    }
     return true;
 }
 
@@ -119,18 +734,29 @@ void flow::FlowPath::clearTileFromWaypointCache(const FlowTile & tile)
 
 uint8 FlowPath::getDataFor(const TilePoint & p) const
 {
-    auto tile = tileMap.Find(p.tileLocation);
-    if (tile == nullptr || !isValidTileLocation(p.pointInTile)) {
+    auto tile = tileGrid.find(p.tileLocation);
+    // the cells of paged out tiles are not read from the store one by one, that would load the whole tile file for every cell
+    if (tile == nullptr || !tile->isResident() || !isValidTileLocation(p.pointInTile)) {
         return BLOCKED;
     }
-    
-    int32 index = (*tile)->toIndex(p.pointInTile);
-    return (*tile)->getData()[index];
+    return tile->getData(p.pointInTile);
+}
+
+TilePoint FlowPath::toTilePoint(const FIntPoint& cell) const
+{
+    // floor division, so the cells left of and above the origin belong to the negative tiles
+    FIntPoint tileLocation(cell.X >= 0 ? cell.X / tileLength : (cell.X + 1) / tileLength - 1, cell.Y >= 0 ? cell.Y / tileLength : (cell.Y + 1) / tileLength - 1);
+    return { tileLocation, cell - tileLocation * tileLength };
+}
+
+uint8 FlowPath::getCellData(const FIntPoint& cell) const
+{
+    return getDataFor(toTilePoint(cell));
 }
 
 PathSearchResult FlowPath::findDirectPath(FIntPoint start, FIntPoint end)
 {
-    return (*tileMap.Find(FIntPoint(1, 1)))->findPath(start, end);
+    return tileGrid.find(FIntPoint(1, 1))->findPath(start, end);
 }
 
 void FlowPath::updatePortals(FIntPoint tileCoordinates) {
@@ -164,8 +790,7 @@ void FlowPath::updatePortals(FIntPoint tileCoordinates) {
 }
 
 FlowTile *FlowPath::getTile(FIntPoint tileCoordinates) {
-    auto tile = tileMap.Find(tileCoordinates);
-    return tile == nullptr ? nullptr : tile->Get();
+    return tileGrid.find(tileCoordinates);
 }
 
 PortalSearchResult FlowPath::findPortalPath(const TileVector& vector, bool useCache)
@@ -200,6 +825,8 @@ void FlowPath::deleteFromPathCache(const TilePoint & targetKey)
 PortalSearchResult FlowPath::checkCache(const Portal* start, const FIntPoint& key) const
 {
     PortalSearchResult result;
+    INC_DWORD_STAT(STAT_WaypointCacheLookups);
+    getCounters().waypointCacheLookups.Increment();
     const CacheEntry* cacheEntry = waypointCache.Find(start);
     if (cacheEntry == nullptr) {
         return result;
@@ -217,6 +844,11 @@ PortalSearchResult FlowPath::checkCache(const Portal* start, const FIntPoint& ke
             start = (*cacheEntry)[key].toPortal;
             if (start == nullptr) {
                 result.success = result.waypoints.Num() % 2 == 0;
+                result.usedCache = result.success;
+                if (result.success) {
+                    INC_DWORD_STAT(STAT_WaypointCacheHits);
+                    getCounters().waypointCacheHits.Increment();
+                }
                 return result;
             }
             cacheEntry = waypointCache.Find(start);
@@ -239,13 +871,17 @@ std::function<void(TArray<uint8>&)> flow::FlowPath::createFlowmapDataProvider(FI
             int32 deltaX = delta.X * (xFactor ? 1 : 0);
             int32 deltaY = delta.Y * (yFactor ? 1 : 0);
 
-            auto tile = tileMap.Find(startTile + FIntPoint(deltaX, deltaY));
-            auto& tileData = tile == nullptr ? fullTileData : (*tile)->getData();
+            auto tile = tileGrid.find(startTile + FIntPoint(deltaX, deltaY));
+            // paged out neighbors are treated as blocked
+            bool isBlocked = tile == nullptr || !tile->isResident();
             for (int32 y = 0; y < tileLength; y++) {
-                for (int32 x = 0; x < tileLength; x++) {
-                    int32 sourceIndex = x + y * tileLength;
-                    int32 targetIndex = toFourTileIndex(isRight, isDown, x, y, tileLength);
-                    data[targetIndex] = tileData[sourceIndex];
+                // the rows of a tile stay contiguous in the four tile data, so compressed tiles are decoded row by row
+                uint8* row = &data[toFourTileIndex(isRight, isDown, 0, y, tileLength)];
+                if (isBlocked) {
+                    FMemory::Memset(row, BLOCKED, tileLength);
+                }
+                else {
+                    tile->copyRow(y, row);
                 }
             }
         }
@@ -286,39 +922,43 @@ PortalSearchResult FlowPath::findPortalPath(const TilePoint& start, const TilePo
     // but it speeds up searches from different start cells to the same target and tends to keep groups together.
 
     PortalSearchResult result;
-    auto startTile = tileMap.Find(start.tileLocation);
-    auto endTile = tileMap.Find(end.tileLocation);
+    auto startTile = tileGrid.find(start.tileLocation);
+    auto endTile = tileGrid.find(end.tileLocation);
     FIntPoint startPoint = start.pointInTile;
     FIntPoint endPoint = end.pointInTile;
     int32 absoluteEndX = endPoint.X + end.tileLocation.X * tileLength;
     int32 absoluteEndY = endPoint.Y + end.tileLocation.Y * tileLength;
     FIntPoint absoluteEnd(absoluteEndX, absoluteEndY);
 
-    // sanity checks
-    if (startTile == nullptr || endTile == nullptr || !isValidTileLocation(startPoint) || !isValidTileLocation(endPoint) ||
-        (*startTile)->getData(startPoint) == BLOCKED || (*endTile)->getData(endPoint) == BLOCKED) {
+    // sanity checks, the cell data of the start and end tile is read by the search
+    if (startTile == nullptr || endTile == nullptr || !startTile->isResident() || !endTile->isResident() || !isValidTileLocation(startPoint) || !isValidTileLocation(endPoint) ||
+        startTile->getData(startPoint) == BLOCKED || endTile->getData(endPoint) == BLOCKED) {
         return result;
     }
 
     // check if maybe start and end are already on the same tile
     if (start.tileLocation == end.tileLocation) {
-        PathSearchResult directPath = (*startTile)->findPath(start.pointInTile, end.pointInTile);
+        PathSearchResult directPath = startTile->findPath(start.pointInTile, end.pointInTile);
         if (directPath.success) {
             result.success = true;
             return result;
         }
     }
 
+    FLOWPATH_TRACE_SCOPE("FlowPath.PortalSearch");
+    INC_DWORD_STAT(STAT_PortalSearches);
+    getCounters().portalSearches.Increment();
+
     // we construct two special portals so they can be inserted into the search queue nodes
     TArray<PortalSearchNode> searchQueue;
-    Portal startPortal(startPoint, startPoint, Orientation::NONE, startTile->Get());
-    Portal endPortal(endPoint, endPoint, Orientation::NONE, endTile->Get());
+    Portal startPortal(startPoint, startPoint, Orientation::NONE, startTile);
+    Portal endPortal(endPoint, endPoint, Orientation::NONE, endTile);
     PortalSearchNode startNode = { -1, -1, &startPortal, &startPortal, false };
     TSet<const Portal*> queuedPortals;
 
     // start by inserting the portals in the start tile into the queue
-    for (auto& portal : (*startTile)->getPortals()) {
-        PathSearchResult searchResult = (*startTile)->findPath(startPoint, portal.center);
+    for (auto& portal : startTile->getPortals()) {
+        PathSearchResult searchResult = startTile->findPath(startPoint, portal.center);
         if (searchResult.success) {
             PortalSearchResult cacheResult = useCache ? checkCache(&portal, absoluteEnd) : PortalSearchResult();
             if (cacheResult.success) {
@@ -365,6 +1005,7 @@ PortalSearchResult FlowPath::findPortalPath(const TilePoint& start, const TilePo
                     result.waypoints.Append(cacheResult.waypoints);
                     cachePortalPath(end, result.waypoints);
                     result.success = true;
+                    result.usedCache = true;
                     break;
                 }
             }
@@ -372,7 +1013,7 @@ PortalSearchResult FlowPath::findPortalPath(const TilePoint& start, const TilePo
 
         // if we are on the goal tile we try to reach the target point from the portal
         if (frontierPortal->tileCoordinates == end.tileLocation) {
-            PathSearchResult searchResult = (*endTile)->findPath(frontierPortal->center, end.pointInTile);
+            PathSearchResult searchResult = endTile->findPath(frontierPortal->center, end.pointInTile);
             if (searchResult.success) {
                 int32 nodeCost = frontier.nodeCost + searchResult.pathCost;
                 PortalSearchNode endNode = { nodeCost, nodeCost, &endPortal, frontierPortal, true };
@@ -393,14 +1034,19 @@ PortalSearchResult FlowPath::findPortalPath(const TilePoint& start, const TilePo
         }
     }
 
+    // the start portal is not expanded by the search
+    int32 expandedNodes = searchedNodes.Num() - 1;
+    INC_DWORD_STAT_BY(STAT_PortalNodesExpanded, expandedNodes);
+    getCounters().portalNodesExpanded.Add(expandedNodes);
+    getCounters().portalNodesPerSearch.add(expandedNodes);
     return result;
 }
 
 TArray<FIntPoint> FlowPath::getAllValidTileCoordinates() const
 {
     TArray<FIntPoint> result;
-    for (auto& pair : tileMap) {
-        result.Add(pair.Key);
+    for (auto& tile : tileGrid.getTiles()) {
+        result.Add(tile->getCoordinates());
     }
     return result;
 }
@@ -409,8 +1055,8 @@ TArray<const Portal*> FlowPath::getAllPortals() const
 {
     TArray<const Portal*> result;
 
-    for (auto& tilePair : tileMap) {
-        for (auto& portal : tilePair.Value->getPortals()) {
+    for (auto& tile : tileGrid.getTiles()) {
+        for (auto& portal : tile->getPortals()) {
             result.Add(&portal);
         }
     }
@@ -422,9 +1068,9 @@ TArray<const Portal*> flow::FlowPath::getAllTilePortals(FIntPoint tileCoordinate
 {
     TArray<const Portal*> result;
 
-    auto tile = tileMap.Find(tileCoordinates);
+    auto tile = tileGrid.find(tileCoordinates);
     if (tile != nullptr) {
-        for (auto& portal : (*tile)->getPortals()) {
+        for (auto& portal : tile->getPortals()) {
             result.Add(&portal);
         }
     }
@@ -435,8 +1081,8 @@ TArray<const Portal*> flow::FlowPath::getAllTilePortals(FIntPoint tileCoordinate
 TMap<FIntPoint, TArray<TArray<EikonalCellValue>>> flow::FlowPath::getAllFlowMaps() const
 {
     TMap<FIntPoint, TArray<TArray<EikonalCellValue>>> result;
-    for (auto& tile : tileMap) {
-        result.Add(tile.Key, tile.Value->getAllFlowMaps());
+    for (auto& tile : tileGrid.getTiles()) {
+        result.Add(tile->getCoordinates(), tile->getAllFlowMaps());
     }
     return result;
 }
@@ -452,14 +1098,17 @@ int32 FlowPath::fastFlowMapLookup(const TileVector& vector, const Portal* nextPo
             return -1;
         }
         // get flowmap to direct target location
-        auto tile = tileMap.Find(vector.end.tileLocation);
+        auto tile = tileGrid.find(vector.end.tileLocation);
         if (tile == nullptr) {
             UE_LOG(LogExec, Warning, TEXT("End location tile (%d, %d) not found."), vector.end.tileLocation.X, vector.end.tileLocation.Y);
             return -1;
         }
+        if (!tile->isResident()) {
+            return -1;
+        }
         // TODO add lookahead if target tile is diagonal start tile
         TArray<FIntPoint> targets = { vector.end.pointInTile };
-        const auto& tileFlowMap = (*tile)->createMapToTarget(targets, true);
+        const auto& tileFlowMap = tile->createMapToTarget(targets, true);
         int32 direction = tileFlowMap[cellIndex].directionLookupIndex;
         if (direction == -1) {
             UE_LOG(LogExec, Warning, TEXT("Unable to calculate flowmap value for agent"));
@@ -470,14 +1119,14 @@ int32 FlowPath::fastFlowMapLookup(const TileVector& vector, const Portal* nextPo
         check(connectedPortal != nullptr);
 
         // get flowmap to target portals
-        auto tile = tileMap.Find(vector.start.tileLocation);
-        if (tile == nullptr) {
+        auto tile = tileGrid.find(vector.start.tileLocation);
+        if (tile == nullptr || !tile->isResident()) {
             return -1;
         }
 
         auto delta = lookaheadPortal == nullptr ? FIntPoint::ZeroValue : lookaheadPortal->tileCoordinates - vector.start.tileLocation;
         if (delta.SizeSquared() != 2) {
-            auto& tileFlowMap = (*tile)->createMapToPortal(nextPortal, connectedPortal);
+            auto& tileFlowMap = tile->createMapToPortal(nextPortal, connectedPortal);
             int32 direction = tileFlowMap[cellIndex].directionLookupIndex;
             if (direction == -1) {
                 for (int32 i = 0; i < 10; i++) {
@@ -495,7 +1144,7 @@ int32 FlowPath::fastFlowMapLookup(const TileVector& vector, const Portal* nextPo
             return direction;
         }
         auto dataProvider = createFlowmapDataProvider(vector.start.tileLocation, delta);
-        auto& tileFlowMap = (*tile)->createLookaheadFlowmap(nextPortal, lookaheadPortal, dataProvider);
+        auto& tileFlowMap = tile->createLookaheadFlowmap(nextPortal, lookaheadPortal, dataProvider);
         int32 direction = tileFlowMap[cellIndex].directionLookupIndex;
         if (direction == -1) {
             UE_LOG(LogExec, Warning, TEXT("Unable to calculate flowmap value for agent"));
@@ -504,16 +1153,114 @@ int32 FlowPath::fastFlowMapLookup(const TileVector& vector, const Portal* nextPo
     }
 }
 
+bool flow::FlowPath::cachedFlowMapLookup(const TileVector& vector, const Portal* nextPortal, const Portal* connectedPortal, const Portal* lookaheadPortal, int32& direction) const
+{
+    // same as the fast lookup, but it never creates a flowmap, so it can be called concurrently
+    auto tile = tileGrid.find(nextPortal == nullptr ? vector.end.tileLocation : vector.start.tileLocation);
+    if (tile == nullptr) {
+        return false;
+    }
+
+    const TArray<EikonalCellValue>* tileFlowMap;
+    if (nextPortal == nullptr) {
+        if (vector.start.tileLocation != vector.end.tileLocation) {
+            return false;
+        }
+        TArray<FIntPoint> targets = { vector.end.pointInTile };
+        tileFlowMap = tile->findTargetFlowMap(targets);
+    }
+    else {
+        auto delta = lookaheadPortal == nullptr ? FIntPoint::ZeroValue : lookaheadPortal->tileCoordinates - vector.start.tileLocation;
+        tileFlowMap = tile->findFlowMap(nextPortal, delta.SizeSquared() == 2 ? lookaheadPortal : connectedPortal);
+    }
+    if (tileFlowMap == nullptr) {
+        // a missing flowmap is counted as a miss once it is created
+        return false;
+    }
+    INC_DWORD_STAT(STAT_FlowMapCacheHits);
+    getCounters().flowMapCacheHits.Increment();
+
+    auto& cellLocation = vector.start.pointInTile;
+    direction = (*tileFlowMap)[cellLocation.X + cellLocation.Y * tileLength].directionLookupIndex;
+    return direction >= 0;
+}
+
 bool flow::FlowPath::hasFlowMap(const Portal * startPortal, const Portal * targetPortal) const
 {
     if (startPortal == nullptr || targetPortal == nullptr) {
         return false;
     }
-    auto tile = tileMap.Find(startPortal->tileCoordinates);
+    auto tile = tileGrid.find(startPortal->tileCoordinates);
     if (tile == nullptr) {
         return false;
     }
-    return (*tile)->hasFlowMap(startPortal, targetPortal);
+    return tile->hasFlowMap(startPortal, targetPortal);
+}
+
+bool flow::FlowPath::approximatePortalDirection(const TilePoint& start, const Portal* portal, FVector2D& direction) const
+{
+    auto tile = tileGrid.find(start.tileLocation);
+    if (tile == nullptr || portal == nullptr || portal->tileCoordinates != start.tileLocation || !tile->isResident()) {
+        return false;
+    }
+
+    // the agent should leave the tile through the window, so it steers to the cell behind it
+    FIntPoint outward = FIntPoint::ZeroValue;
+    switch (portal->orientation) {
+    case Orientation::LEFT: outward.X = -1; break;
+    case Orientation::RIGHT: outward.X = 1; break;
+    case Orientation::TOP: outward.Y = -1; break;
+    case Orientation::BOTTOM: outward.Y = 1; break;
+    default: break;
+    }
+
+    auto& location = start.pointInTile;
+    FIntPoint closest(FMath::Clamp(location.X, portal->start.X, portal->end.X), FMath::Clamp(location.Y, portal->start.Y, portal->end.Y));
+    const FIntPoint candidates[] = { closest, portal->center, portal->start, portal->end };
+    for (auto& candidate : candidates) {
+        if (hasLineOfSight(*tile, location, candidate)) {
+            direction = FVector2D(candidate + outward - location).GetSafeNormal();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool flow::FlowPath::isInLineOfSight(const TilePoint& start, const TilePoint& end) const
+{
+    auto tile = tileGrid.find(start.tileLocation);
+    if (tile == nullptr || start.tileLocation != end.tileLocation || !tile->isResident() || !isValidTileLocation(start.pointInTile) || !isValidTileLocation(end.pointInTile)) {
+        return false;
+    }
+    return hasLineOfSight(*tile, start.pointInTile, end.pointInTile);
+}
+
+bool flow::FlowPath::hasLineOfSight(const FlowTile& tile, FIntPoint from, FIntPoint to) const
+{
+    // bresenham line over the cells of the tile, the cells are read one by one so compressed tiles are not decoded
+    int32 deltaX = FMath::Abs(to.X - from.X);
+    int32 deltaY = -FMath::Abs(to.Y - from.Y);
+    int32 stepX = from.X < to.X ? 1 : -1;
+    int32 stepY = from.Y < to.Y ? 1 : -1;
+    int32 error = deltaX + deltaY;
+    FIntPoint p = from;
+    while (true) {
+        if (tile.getData(p) == BLOCKED) {
+            return false;
+        }
+        if (p == to) {
+            return true;
+        }
+        int32 doubleError = 2 * error;
+        if (doubleError >= deltaY) {
+            error += deltaY;
+            p.X += stepX;
+        }
+        if (doubleError <= deltaX) {
+            error += deltaX;
+            p.Y += stepY;
+        }
+    }
 }
 
 void flow::FlowPath::createFlowMapSourceData(FIntPoint startTile, FIntPoint delta, TArray<uint8>& result)
@@ -522,25 +1269,73 @@ void flow::FlowPath::createFlowMapSourceData(FIntPoint startTile, FIntPoint delt
     dataProvider(result);
 }
 
-void flow::FlowPath::cacheFlowMap(const Portal * resultStartPortal, const Portal * resultEndPortal, const TArray<flow::EikonalCellValue>& result)
+void flow::FlowPath::cacheFlowMap(const Portal * resultStartPortal, const Portal * resultEndPortal, TArray<flow::EikonalCellValue>&& result)
 {
-    if (resultStartPortal == nullptr || resultEndPortal == nullptr) {
+    auto tile = resultStartPortal == nullptr || resultEndPortal == nullptr ? nullptr : tileGrid.find(resultStartPortal->tileCoordinates);
+    if (tile == nullptr || !tile->isResident() || tile->hasFlowMap(resultStartPortal, resultEndPortal)) {
+        // the buffer of a discarded result is reused by the next solve
+        getFlowMapPool().release(MoveTemp(result));
         return;
     }
-    auto tile = tileMap.Find(resultStartPortal->tileCoordinates);
-    if (tile == nullptr || (*tile)->hasFlowMap(resultStartPortal, resultEndPortal)) {
+    tile->cacheFlowMap(resultStartPortal, resultEndPortal, MoveTemp(result));
+}
+
+bool flow::FlowPath::hasTargetFlowMap(const TilePoint& target) const
+{
+    auto tile = tileGrid.find(target.tileLocation);
+    if (tile == nullptr) {
+        return false;
+    }
+    TArray<FIntPoint> targets = { target.pointInTile };
+    return tile->findTargetFlowMap(targets) != nullptr;
+}
+
+void flow::FlowPath::cacheTargetFlowMap(const TilePoint& target, TArray<flow::EikonalCellValue>&& result)
+{
+    auto tile = tileGrid.find(target.tileLocation);
+    if (tile == nullptr || !tile->isResident()) {
+        getFlowMapPool().release(MoveTemp(result));
         return;
     }
-    (*tile)->cacheFlowMap(resultStartPortal, resultEndPortal, result);
+    TArray<FIntPoint> targets = { target.pointInTile };
+    if (tile->findTargetFlowMap(targets) == nullptr) {
+        tile->cacheTargetFlowMap(targets, MoveTemp(result));
+    }
+    else {
+        getFlowMapPool().release(MoveTemp(result));
+    }
+}
+
+bool flow::FlowPath::copyTileData(const FIntPoint& tileCoordinates, TArray<uint8>& result) const
+{
+    auto tile = tileGrid.find(tileCoordinates);
+    if (tile == nullptr || !tile->isResident()) {
+        return false;
+    }
+    tile->copyData(result);
+    return true;
+}
+
+bool flow::FlowPath::readTileData(const FIntPoint& tileCoordinates, TArray<uint8>& result) const
+{
+    auto tile = tileGrid.find(tileCoordinates);
+    if (tile == nullptr) {
+        return false;
+    }
+    if (!tile->isResident()) {
+        return tileStore->load(tileCoordinates, result);
+    }
+    tile->copyData(result);
+    return true;
 }
 
 void flow::FlowPath::deleteFlowMapsFromTile(const FIntPoint & tileCoordinates)
 {
-    auto tile = tileMap.Find(tileCoordinates);
+    auto tile = tileGrid.find(tileCoordinates);
     if (tile == nullptr) {
         return;
     }
-    return (*tile)->deleteAllFlowMaps();
+    return tile->deleteAllFlowMaps();
 }
 
 int32 flow::FlowPath::getTileLength() const
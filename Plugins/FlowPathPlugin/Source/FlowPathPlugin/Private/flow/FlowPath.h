@@ -5,12 +5,14 @@
 #pragma once
 
 #include "FlowTile.h"
+#include "TileGrid.h"
+#include "TileStore.h"
+#include "FlowMapDiskCache.h"
 
 namespace flow {
 
     const bool xFactorArray[4] = { false, true, false, true };
     const bool yFactorArray[4] = { false, false, true, true };
-    typedef TMap<FIntPoint, TUniquePtr<FlowTile>> TileMap;
     
     struct Agent {
         FVector2D acceleration;
@@ -40,6 +42,8 @@ namespace flow {
 
     struct PortalSearchResult {
         bool success = false;
+        // true if the route was completed with the waypoint cache
+        bool usedCache = false;
         TArray<const Portal*> waypoints;
     };
 
@@ -64,6 +68,30 @@ namespace flow {
     typedef TMap<FIntPoint, PortalLink> CacheEntry;
     typedef TMap<const Portal*, CacheEntry> WaypointCache;
 
+    /** The cell data that one paging pass moves between the tiles and the tile store. */
+    struct TilePagingBatch {
+        TArray<FIntPoint> loadedTiles;
+        TArray<TArray<uint8>> loadedData;
+        TArray<FIntPoint> savedTiles;
+        TArray<TArray<uint8>> savedData;
+        TArray<bool> isSaved;
+
+        bool isEmpty() const;
+    };
+
+    enum class CellUpdateResult {
+        // the data was invalid
+        Failed,
+        // the data was the same as before
+        Unchanged,
+        // the portals and their connections are the same objects as before
+        InteriorUpdated,
+        // the portals are the same objects as before, but the connections inside the tile have changed
+        ConnectionsUpdated,
+        // the tile and its portals were recreated
+        TileRebuilt
+    };
+
     class FlowPath {
     private:
         TArray<uint8> emptyTileData;
@@ -72,9 +100,38 @@ namespace flow {
         // TODO: add precomputed flowfield for empty tiles
 
         int32 tileLength;
-        TileMap tileMap;
+        TileGrid<FlowTile> tileGrid;
         WaypointCache waypointCache;
 
+        // while a bulk update is open the rebuilt tiles are connected and the waypoint cache is cleared only once at the end
+        bool isBulkUpdateOpen = false;
+        bool isWaypointCacheDirty = false;
+        TSet<FIntPoint> unconnectedTiles;
+
+        // only used if paging is enabled, the cell data of the tiles that are not resident is kept in the store
+        TUniquePtr<TileStore> tileStore;
+        // the last tick each tile with resident data or flowmaps was used in
+        TMap<FIntPoint, uint32> residentTiles;
+        // the tiles whose data in the store is up to date
+        TSet<FIntPoint> storedTiles;
+        // the number of paging batches that load or save each tile and are not applied yet
+        TMap<FIntPoint, int32> pagingTiles;
+        // the tiles that changed while they were saved, their stored data is outdated
+        TSet<FIntPoint> outdatedPagingTiles;
+        uint32 currentTick = 0;
+
+        TUniquePtr<FlowMapDiskCache> diskCache;
+
+        void markTileChanged(const FIntPoint& coord);
+
+        /** Drops the cell data and flowmaps of the tile, the data has to be stored already. */
+        void pageOutTile(const FIntPoint& coord);
+
+        void addTileLoad(const FIntPoint& coord, TilePagingBatch& batch);
+
+        /** Returns true if no other batch loads or saves the tile anymore. */
+        bool releasePagingTile(const FIntPoint& coord);
+
         void updatePortals(FIntPoint tileCoordinates);
 
         FlowTile *getTile(FIntPoint tileCoordinates);
@@ -89,15 +146,117 @@ namespace flow {
 
         void clearTileFromWaypointCache(const FlowTile& tile);
 
+        void rebuildTile(const FIntPoint& coord, const TArray<uint8>& tileData);
+
+        CellUpdateResult applyTileData(FlowTile* tile, const TArray<uint8>& newData, const TArray<int32>& changedCells);
+
+        bool hasLineOfSight(const FlowTile& tile, FIntPoint from, FIntPoint to) const;
+
     public:
         explicit FlowPath(int32 tileLength);
 
         bool updateMapTile(int32 tileX, int32 tileY, const TArray<uint8> &tileData);
 
+        /** Same as updateMapTile, but the existing tile keeps its portal objects if the portal windows have not changed. */
+        CellUpdateResult replaceTileData(const FIntPoint& tileCoordinates, const TArray<uint8>& tileData);
+
+        bool isValidTileData(const TArray<uint8>& tileData) const;
+
+        /** Constructs a tile without adding it to the map. Thread safe, so tiles can be built on worker threads. */
+        FlowTile* createTile(const FIntPoint& coord, const TArray<uint8>& tileData);
+
+        /** Replaces the tile at the coordinates of the given tile with it and connects it with its neighbors. */
+        void publishTile(TUniquePtr<FlowTile> tile);
+
+        /**
+        * Same as replaceTileData for several tiles. The tiles that do not exist yet are constructed in parallel and connected with each other
+        * in conflict free passes over their edges, before they are added to the map.
+        */
+        TArray<CellUpdateResult> replaceTilesData(const TArray<FIntPoint>& tileCoordinates, const TArray<TArray<uint8>>& tilesData);
+
+        /**
+        * Writes the part of the cell region (in absolute cell coordinates) that overlaps the given tile.
+        * Changes that keep the portal windows are applied in place, otherwise the tile is rebuilt.
+        */
+        CellUpdateResult updateMapCells(const FIntPoint& tileCoordinates, const FIntPoint& regionOrigin, const FIntPoint& regionSize, const TArray<uint8>& regionData);
+
+        /**
+        * Checks the whole cell region before any tile is changed: the data must not contain 0 values and all overlapped tiles must exist.
+        * Pages in the overlapped tiles. Returns false if the region can not be applied completely.
+        */
+        bool prepareMapCellsUpdate(const FIntPoint& regionOrigin, const FIntPoint& regionSize, const TArray<uint8>& regionData);
+
+        /**
+        * Starts a bulk update. The tiles that are rebuilt until the end of the update are not connected to their neighbors,
+        * so no path search must be done before endBulkUpdate is called.
+        */
+        void beginBulkUpdate();
+
+        /** Connects all tiles rebuilt since beginBulkUpdate with their neighbors and clears the waypoint cache once if needed. */
+        void endBulkUpdate();
+
+        /**
+        * Keeps only the cell data and flowmaps of the recently used tiles in memory, the data of the other tiles is written to the store directory.
+        * The portals of all tiles stay resident, so portal searches work across the whole map.
+        */
+        void enablePaging(const FString& storeDirectory);
+
+        bool isPagingEnabled() const;
+
+        /**
+        * Plans to page in the used tiles and to page out the least recently used other tiles until at most maxResidentTiles are resident.
+        * The required tiles are loaded by the required batch, the other used tiles are prefetched and the tiles to page out are saved by the prefetch batch.
+        * Tiles whose data is already stored are paged out right away. Must not be called while other threads read tile data.
+        */
+        void planResidentTiles(const TSet<FIntPoint>& usedTiles, const TSet<FIntPoint>& requiredTiles, int32 maxResidentTiles, TilePagingBatch& requiredBatch, TilePagingBatch& prefetchBatch);
+
+        /** Plans to load the given tiles that are not resident, even if a prefetch of them is still running. Must not be called while other threads read tile data. */
+        void planTileLoads(const TSet<FIntPoint>& tiles, TilePagingBatch& batch);
+
+        /** Loads and saves the cell data of the batch. Only the tile store is accessed, so no lock is needed and any thread can do it. */
+        void transferTiles(TilePagingBatch& batch) const;
+
+        /** Pages in the loaded and pages out the saved tiles of the batch, the tiles that changed in the meantime are skipped. Must not be called while other threads read tile data. */
+        void applyTilePaging(TilePagingBatch& batch);
+
+        /** Loads the cell data of the tile from the store if it was paged out. Must not be called while other threads read tile data. */
+        bool ensureResident(FlowTile* tile);
+
+        int32 getResidentTileCount() const;
+
+        /** Returns the bytes used by the waypoint cache. */
+        SIZE_T getWaypointCacheSize() const;
+
+        /** Returns the bytes used by the flowmaps cached in all tiles. */
+        SIZE_T getFlowMapCacheSize() const;
+
+        /** Opens the persistent flowmap cache, which is consulted before a flowmap is solved. */
+        bool enableDiskCache(const FString& filename, int64 maxFileSize);
+
+        /** Returns the persistent flowmap cache or null if it is not enabled. */
+        FlowMapDiskCache* getDiskCache() const;
+
+        /**
+        * Writes the tiles, the portal geometry, the portal connections with their costs and optionally the cached flowmaps as baked navigation data.
+        * Portals are stored by index, so loading only has to resolve the indices instead of searching the portals again.
+        */
+        bool writeBake(FArchive& ar, bool includeFlowMaps);
+
+        /** Replaces all tiles with the baked navigation data. Returns false without changing anything if the data is invalid or from another version. */
+        bool readBake(FArchive& ar);
+
+        /** Returns the data of the cell, the cells of paged out tiles are blocked. */
         uint8 getDataFor(const TilePoint& p) const;
 
+        /** Splits the absolute cell coordinates into the tile and the cell inside the tile. */
+        TilePoint toTilePoint(const FIntPoint& cell) const;
+
+        /** Returns the data of the cell at the absolute cell coordinates, the cells outside of all tiles or in paged out tiles are blocked. */
+        uint8 getCellData(const FIntPoint& cell) const;
+
         PathSearchResult findDirectPath(FIntPoint start, FIntPoint end);
 
+        /** Searches the portal route between the points. Fails if the start or end tile is paged out, as their cell data is searched. */
         PortalSearchResult findPortalPath(const TilePoint& start, const TilePoint& end, bool useCache);
 
         PortalSearchResult findPortalPath(const TileVector& vector, bool useCache);
@@ -116,11 +275,31 @@ namespace flow {
 
         int32 fastFlowMapLookup(const TileVector& vector, const Portal* nextPortal, const Portal* connectedPortal, const Portal* lookaheadPortal);
 
+        bool cachedFlowMapLookup(const TileVector& vector, const Portal* nextPortal, const Portal* connectedPortal, const Portal* lookaheadPortal, int32& direction) const;
+
         bool hasFlowMap(const Portal* startPortal, const Portal* targetPortal) const;
 
+        /**
+        * Calculates the direction from the start to a visible cell of the portal window without a flowmap. The start has to be in the tile of the portal.
+        * Returns false if no cell of the window is in the line of sight.
+        */
+        bool approximatePortalDirection(const TilePoint& start, const Portal* portal, FVector2D& direction) const;
+
+        /** Returns true if no blocked cell lies on the straight line between the two points, which have to be in the same resident tile. */
+        bool isInLineOfSight(const TilePoint& start, const TilePoint& end) const;
+
         void createFlowMapSourceData(FIntPoint startTile, FIntPoint delta, TArray<uint8>& result);
 
-        void cacheFlowMap(const Portal * resultStartPortal, const Portal * resultEndPortal, const TArray<flow::EikonalCellValue>& result);
+        void cacheFlowMap(const Portal * resultStartPortal, const Portal * resultEndPortal, TArray<flow::EikonalCellValue>&& result);
+
+        bool hasTargetFlowMap(const TilePoint& target) const;
+
+        void cacheTargetFlowMap(const TilePoint& target, TArray<flow::EikonalCellValue>&& result);
+
+        bool copyTileData(const FIntPoint& tileCoordinates, TArray<uint8>& result) const;
+
+        /** Same as copyTileData, but the data of paged out tiles is read from the store without paging them in. */
+        bool readTileData(const FIntPoint& tileCoordinates, TArray<uint8>& result) const;
 
         void deleteFlowMapsFromTile(const FIntPoint& tileCoordinates);
 
@@ -6,16 +6,89 @@
 #include <queue>
 #include "FlowPath.h"
 #include "EikonalSolver.h"
+#include "FlowMapDiskCache.h"
+#include "FlowMapPool.h"
+#include "Counters.h"
+#include "ChromeTrace.h"
+#include "Containers/LockFreeFixedSizeAllocator.h"
 
 //For UE4 Profiler ~ Stat
 DECLARE_CYCLE_STAT(TEXT("FlowPath tile ~ initialization"), STAT_TileInit, STATGROUP_FlowPath);
 DECLARE_CYCLE_STAT(TEXT("FlowPath tile ~ find inner path"), STAT_TileInnerPath, STATGROUP_FlowPath); 
 DECLARE_CYCLE_STAT(TEXT("FlowPath tile ~ create flow field"), STAT_TilePortalFlowmap, STATGROUP_FlowPath);
 DECLARE_CYCLE_STAT(TEXT("FlowPath tile ~ create lookahead flow field"), STAT_TilePortalLookaheadFlowmap, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath flowmap cache ~ misses"), STAT_FlowMapCacheMisses, STATGROUP_FlowPath);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FlowPath flowmap ~ synchronous solves"), STAT_SyncFlowMapSolves, STATGROUP_FlowPath);
 
 using namespace std;
 using namespace flow;
 
+static void countEvictedFlowMaps(int32 count)
+{
+    INC_DWORD_STAT_BY(STAT_FlowMapCacheEvictions, count);
+    getCounters().flowMapCacheEvictions.Add(count);
+}
+
+typedef TLockFreeFixedSizeAllocator<sizeof(FlowTile), PLATFORM_CACHE_LINE_SIZE, FThreadSafeCounter> FlowTileAllocator;
+
+static FlowTileAllocator& getTileAllocator()
+{
+    // never destroyed, because the tiles of a world can outlive the static objects at shutdown
+    static FlowTileAllocator* allocator = new FlowTileAllocator();
+    return *allocator;
+}
+
+void* flow::FlowTile::operator new(size_t size)
+{
+    check(size == sizeof(FlowTile));
+    return getTileAllocator().Allocate();
+}
+
+void flow::FlowTile::operator delete(void* tile)
+{
+    getTileAllocator().Free(tile);
+}
+
+SIZE_T flow::FlowTile::getPooledSize()
+{
+    return SIZE_T(getTileAllocator().GetNumFree().GetValue()) * sizeof(FlowTile);
+}
+
+// how the cell data of a tile is stored in baked navigation data
+const uint8 BakedOwnData = 0;
+const uint8 BakedEmptyData = 1;
+const uint8 BakedFullData = 2;
+
+static bool isValidBakedPortal(const FIntPoint& start, const FIntPoint& end, Orientation orientation, int32 tileLength)
+{
+    int32 maxIndex = tileLength - 1;
+    if (start.X < 0 || start.Y < 0 || end.X > maxIndex || end.Y > maxIndex || start.X > end.X || start.Y > end.Y) {
+        return false;
+    }
+    // the window lies on the border of its side and only extends along it
+    switch (orientation) {
+    case Orientation::LEFT: return start.X == 0 && end.X == 0;
+    case Orientation::RIGHT: return start.X == maxIndex && end.X == maxIndex;
+    case Orientation::TOP: return start.Y == 0 && end.Y == 0;
+    case Orientation::BOTTOM: return start.Y == maxIndex && end.Y == maxIndex;
+    default: return false;
+    }
+}
+
+static bool isValidBakedFlowMap(const TArray<EikonalCellValue>& flowMap, int32 tileLength)
+{
+    if (flowMap.Num() != tileLength * tileLength) {
+        return false;
+    }
+    for (auto& cell : flowMap) {
+        // the direction indexes the neighbor tables, -1 marks unreachable cells
+        if (cell.directionLookupIndex < -1 || cell.directionLookupIndex >= 8) {
+            return false;
+        }
+    }
+    return true;
+}
+
 const TArray<Portal>& flow::FlowTile::getPortals() const
 {
     return portals;
@@ -26,7 +99,8 @@ const FIntPoint & flow::FlowTile::getCoordinates() const
     return coordinates;
 }
 
-FlowTile::FlowTile(const TArray<uint8> &tileData, int32 tileLength, FIntPoint coordinates) : tileData(tileData), fixedTileData(nullptr), coordinates(coordinates), tileLength(tileLength) {
+FlowTile::FlowTile(const TArray<uint8> &tileData, int32 tileLength, FIntPoint coordinates) : fixedTileData(nullptr), coordinates(coordinates), tileLength(tileLength) {
+    setOwnData(tileData);
     initPortalData();
 }
 
@@ -35,11 +109,183 @@ flow::FlowTile::FlowTile(TArray<uint8>* fixedTileData, int32 tileLength, FIntPoi
     initPortalData();
 }
 
+flow::FlowTile::~FlowTile()
+{
+    getFlowMapPool().releaseAll(portalEikonalMaps);
+    getFlowMapPool().releaseAll(directEikonalMaps);
+}
+
+flow::FlowTile::FlowTile(FArchive& ar, TArray<uint8>* emptyData, TArray<uint8>* fullData, int32 tileLength, FIntPoint coordinates) : fixedTileData(nullptr), coordinates(coordinates), tileLength(tileLength)
+{
+    uint8 dataKind = BakedOwnData;
+    ar << dataKind;
+    if (dataKind == BakedEmptyData) {
+        fixedTileData = emptyData;
+    }
+    else if (dataKind == BakedFullData) {
+        fixedTileData = fullData;
+    }
+    else {
+        TArray<uint8> data;
+        ar << data;
+        if (data.Num() != tileLength * tileLength) {
+            ar.SetError();
+            return;
+        }
+        setOwnData(data);
+    }
+
+    int32 portalCount = 0;
+    ar << portalCount;
+    if (portalCount < 0 || portalCount > tileLength * 4) {
+        ar.SetError();
+        return;
+    }
+    portals.Reserve(portalCount);
+    for (int32 i = 0; i < portalCount; i++) {
+        FIntPoint start;
+        FIntPoint end;
+        uint8 orientation;
+        ar << start << end << orientation;
+        if (orientation > static_cast<uint8>(Orientation::RIGHT) || !isValidBakedPortal(start, end, static_cast<Orientation>(orientation), tileLength)) {
+            ar.SetError();
+            return;
+        }
+        portals.Emplace(start, end, static_cast<Orientation>(orientation), this);
+    }
+}
+
+void flow::FlowTile::writeBake(FArchive& ar, const TArray<uint8>* emptyData, const TArray<uint8>* fullData) const
+{
+    check(isResident());
+    uint8 dataKind = fixedTileData == nullptr ? BakedOwnData : (fixedTileData == emptyData ? BakedEmptyData : BakedFullData);
+    ar << dataKind;
+    if (dataKind == BakedOwnData) {
+        TArray<uint8> scratch;
+        ar << const_cast<TArray<uint8>&>(getData(scratch));
+    }
+
+    int32 portalCount = portals.Num();
+    ar << portalCount;
+    for (auto& portal : portals) {
+        FIntPoint start = portal.start;
+        FIntPoint end = portal.end;
+        uint8 orientation = static_cast<uint8>(portal.orientation);
+        ar << start << end << orientation;
+    }
+}
+
+void flow::FlowTile::writeBakedConnections(FArchive& ar, TFunctionRef<BakedPortalIndex(const Portal*)> indexOf) const
+{
+    for (auto& portal : portals) {
+        int32 connectionCount = portal.connected.Num();
+        ar << connectionCount;
+        for (auto& connection : portal.connected) {
+            BakedPortalIndex index = indexOf(connection.Key);
+            int32 cost = connection.Value;
+            ar << index.Key << index.Value << cost;
+        }
+    }
+}
+
+bool flow::FlowTile::readBakedConnections(FArchive& ar, TFunctionRef<Portal*(const BakedPortalIndex&)> findPortal)
+{
+    for (auto& portal : portals) {
+        int32 connectionCount = 0;
+        ar << connectionCount;
+        for (int32 i = 0; i < connectionCount && !ar.IsError(); i++) {
+            BakedPortalIndex index;
+            int32 cost;
+            ar << index.Key << index.Value << cost;
+            auto connectedPortal = ar.IsError() ? nullptr : findPortal(index);
+            if (connectedPortal == nullptr || connectedPortal == &portal || cost < 0) {
+                ar.SetError();
+                return false;
+            }
+            portal.connected.Add(connectedPortal, cost);
+        }
+    }
+    return !ar.IsError();
+}
+
+void flow::FlowTile::writeBakedFlowMaps(FArchive& ar, TFunctionRef<BakedPortalIndex(const Portal*)> indexOf) const
+{
+    TArray<TPair<BakedPortalIndex, BakedPortalIndex>> portalKeys;
+    TArray<const TArray<EikonalCellValue>*> portalMaps;
+    for (auto& entry : portalEikonalMaps) {
+        BakedPortalIndex targetIndex = indexOf(entry.Key.targetPortal);
+        BakedPortalIndex connectedIndex = indexOf(entry.Key.connectedPortal);
+        if (targetIndex.Key != INDEX_NONE && connectedIndex.Key != INDEX_NONE) {
+            portalKeys.Emplace(targetIndex, connectedIndex);
+            portalMaps.Add(&entry.Value);
+        }
+    }
+    int32 mapCount = portalMaps.Num();
+    ar << mapCount;
+    for (int32 i = 0; i < mapCount; i++) {
+        ar << portalKeys[i].Key.Key << portalKeys[i].Key.Value << portalKeys[i].Value.Key << portalKeys[i].Value.Value;
+        ar << const_cast<TArray<EikonalCellValue>&>(*portalMaps[i]);
+    }
+
+    mapCount = directEikonalMaps.Num();
+    ar << mapCount;
+    for (auto& entry : directEikonalMaps) {
+        TArray<FIntPoint> targets = entry.Key.targets.Array();
+        ar << targets;
+        ar << const_cast<TArray<EikonalCellValue>&>(entry.Value);
+    }
+}
+
+bool flow::FlowTile::readBakedFlowMaps(FArchive& ar, TFunctionRef<Portal*(const BakedPortalIndex&)> findPortal)
+{
+    int32 mapCount = 0;
+    ar << mapCount;
+    for (int32 i = 0; i < mapCount && !ar.IsError(); i++) {
+        BakedPortalIndex targetIndex;
+        BakedPortalIndex connectedIndex;
+        TArray<EikonalCellValue> flowMap;
+        ar << targetIndex.Key << targetIndex.Value << connectedIndex.Key << connectedIndex.Value << flowMap;
+        if (ar.IsError()) {
+            return false;
+        }
+        auto targetPortal = findPortal(targetIndex);
+        auto connectedPortal = findPortal(connectedIndex);
+        // the flowmap leads to a portal of this tile
+        if (targetPortal == nullptr || connectedPortal == nullptr || targetPortal->parentTile != this || !isValidBakedFlowMap(flowMap, tileLength)) {
+            ar.SetError();
+            return false;
+        }
+        cacheFlowMap(targetPortal, connectedPortal, MoveTemp(flowMap));
+    }
+
+    mapCount = 0;
+    ar << mapCount;
+    for (int32 i = 0; i < mapCount && !ar.IsError(); i++) {
+        TArray<FIntPoint> targets;
+        TArray<EikonalCellValue> flowMap;
+        ar << targets << flowMap;
+        if (ar.IsError()) {
+            return false;
+        }
+        bool areTargetsValid = targets.Num() > 0;
+        for (auto& target : targets) {
+            areTargetsValid &= target.X >= 0 && target.Y >= 0 && target.X < tileLength && target.Y < tileLength;
+        }
+        if (!areTargetsValid || !isValidBakedFlowMap(flowMap, tileLength)) {
+            ar.SetError();
+            return false;
+        }
+        cacheTargetFlowMap(targets, MoveTemp(flowMap));
+    }
+    return !ar.IsError();
+}
+
 void flow::FlowTile::initPortalData()
 {
     SCOPE_CYCLE_COUNTER(STAT_TileInit);
 
-    auto& data = getData();
+    TArray<uint8> scratch;
+    auto& data = getData(scratch);
     int32 maxIndex = tileLength - 1;
 
     //find left portals
@@ -244,6 +490,9 @@ PathSearchResult flow::FlowTile::findPath(FIntPoint start, FIntPoint end)
         // do an improved A* search
         // inspired by https://www.gamasutra.com/view/feature/131505/toward_more_realistic_pathfinding.php
 
+        // compressed tiles are decoded once for the whole search
+        TArray<uint8> scratch;
+        auto& data = getData(scratch);
         int32 tileSize = tileLength * tileLength;
         TArray<bool> initializedTiles;
         initializedTiles.AddZeroed(tileSize);
@@ -262,7 +511,7 @@ PathSearchResult flow::FlowTile::findPath(FIntPoint start, FIntPoint end)
 
         FIntPoint frontier = start;
         do {
-            initializeFrontier(frontier, initializedTiles, nodes, end, openTiles);
+            initializeFrontier(data, frontier, initializedTiles, nodes, end, openTiles);
             int32 frontierCost = -1;
 
             auto it = openTiles.begin();
@@ -285,11 +534,11 @@ PathSearchResult flow::FlowTile::findPath(FIntPoint start, FIntPoint end)
             }
         } while (frontier != end);
 
-        int32 pathCost = getData(start);
+        int32 pathCost = data[startIndex];
         while (frontier != start) {
             wayPoints.Add(frontier);
             int32 nodeIndex = toIndex(frontier);
-            pathCost += getData()[nodeIndex];
+            pathCost += data[nodeIndex];
             frontier = nodes[nodeIndex].parentNode;
         }
         wayPoints.Add(start);
@@ -321,8 +570,12 @@ const TArray<EikonalCellValue>& flow::FlowTile::createMapToPortal(const Portal*
     check(targetPortal->connected.Contains(connectedPortal));
     FlowPortalKey key = { targetPortal, connectedPortal };
     if (portalEikonalMaps.Contains(key)) {
+        INC_DWORD_STAT(STAT_FlowMapCacheHits);
+        getCounters().flowMapCacheHits.Increment();
         return portalEikonalMaps[key];
     }
+    INC_DWORD_STAT(STAT_FlowMapCacheMisses);
+    getCounters().flowMapCacheMisses.Increment();
     {
         SCOPE_CYCLE_COUNTER(STAT_TilePortalFlowmap);
 
@@ -336,7 +589,7 @@ const TArray<EikonalCellValue>& flow::FlowTile::createMapToPortal(const Portal*
             resultMap[index].directionLookupIndex = toDirectionIndex(targetPortal->orientation);
         }
 
-        return portalEikonalMaps.Add(key, resultMap);
+        return portalEikonalMaps.Add(key, MoveTemp(resultMap));
     }
 }
 
@@ -398,11 +651,16 @@ const TArray<EikonalCellValue>& flow::FlowTile::createLookaheadFlowmap(const Por
     check(lookaheadPortal);
     FlowPortalKey key = { targetPortal, lookaheadPortal };
     if (portalEikonalMaps.Contains(key)) {
+        INC_DWORD_STAT(STAT_FlowMapCacheHits);
+        getCounters().flowMapCacheHits.Increment();
         return portalEikonalMaps[key];
     }
+    INC_DWORD_STAT(STAT_FlowMapCacheMisses);
+    getCounters().flowMapCacheMisses.Increment();
 
     {
         SCOPE_CYCLE_COUNTER(STAT_TilePortalLookaheadFlowmap);
+        FLOWPATH_TRACE_SCOPE("FlowTile.LookaheadFlowMapSolve");
         auto delta = lookaheadPortal->tileCoordinates - targetPortal->tileCoordinates;
         bool lookahead = delta.X != 0 && delta.Y != 0;
 
@@ -425,9 +683,10 @@ const TArray<EikonalCellValue>& flow::FlowTile::createLookaheadFlowmap(const Por
         calculateFlowmapTargets(targetPortal, lookaheadPortal, targets);
 
         // create the map, then extract the original tile from it (discard the rest of the flowmap)
-        auto resultMap = CreateEikonalSurface(bigTileData, targets);
-        TArray<EikonalCellValue> extractedMap;
-        extractedMap.AddUninitialized(tileLength * tileLength);
+        INC_DWORD_STAT(STAT_SyncFlowMapSolves);
+        getCounters().syncFlowMapSolves.Increment();
+        auto resultMap = CreateCachedEikonalSurface(bigTileData, targets, diskCache);
+        TArray<EikonalCellValue> extractedMap = getFlowMapPool().acquire(tileLength * tileLength);
         for (int32 y = 0; y < tileLength; y++) {
             for (int32 x = 0; x < tileLength; x++) {
                 int32 sourceIndex = toFourTileIndex(delta.X == -1, delta.Y == -1, x, y, tileLength);
@@ -435,8 +694,9 @@ const TArray<EikonalCellValue>& flow::FlowTile::createLookaheadFlowmap(const Por
                 extractedMap[targetIndex] = resultMap[sourceIndex];
             }
         }
+        getFlowMapPool().release(MoveTemp(resultMap));
 
-        return portalEikonalMaps.Add(key, extractedMap);
+        return portalEikonalMaps.Add(key, MoveTemp(extractedMap));
     }
 }
 
@@ -446,11 +706,22 @@ TArray<EikonalCellValue> flow::FlowTile::createMapToTarget(const TArray<FIntPoin
         FlowTargetKey key(targets);
         auto cachedEntry = directEikonalMaps.Find(key);
         if (cachedEntry != nullptr) {
+            INC_DWORD_STAT(STAT_FlowMapCacheHits);
+            getCounters().flowMapCacheHits.Increment();
             return *cachedEntry;
         }
-        return directEikonalMaps.Add(key, CreateEikonalSurface(getData(), targets));
+        INC_DWORD_STAT(STAT_FlowMapCacheMisses);
+        getCounters().flowMapCacheMisses.Increment();
     }
-    return CreateEikonalSurface(getData(), targets);
+    FLOWPATH_TRACE_SCOPE("FlowTile.FlowMapSolve");
+    INC_DWORD_STAT(STAT_SyncFlowMapSolves);
+    getCounters().syncFlowMapSolves.Increment();
+    TArray<uint8> scratch;
+    auto result = CreateCachedEikonalSurface(getData(scratch), targets, diskCache);
+    if (cacheResult) {
+        directEikonalMaps.Add(FlowTargetKey(targets), result);
+    }
+    return result;
 }
 
 TArray<TArray<EikonalCellValue>> flow::FlowTile::getAllFlowMaps() const
@@ -464,40 +735,108 @@ TArray<TArray<EikonalCellValue>> flow::FlowTile::getAllFlowMaps() const
     return result;
 }
 
+int32 flow::FlowTile::getFlowMapCount() const
+{
+    return portalEikonalMaps.Num() + directEikonalMaps.Num();
+}
+
+SIZE_T flow::FlowTile::getFlowMapsSize() const
+{
+    SIZE_T size = portalEikonalMaps.GetAllocatedSize() + directEikonalMaps.GetAllocatedSize();
+    for (auto& entry : portalEikonalMaps) {
+        size += entry.Value.GetAllocatedSize();
+    }
+    for (auto& entry : directEikonalMaps) {
+        size += entry.Key.targets.GetAllocatedSize() + entry.Value.GetAllocatedSize();
+    }
+    return size;
+}
+
 bool flow::FlowTile::hasFlowMap(const Portal * startPortal, const Portal * targetPortal) const
 {
     return portalEikonalMaps.Contains({ startPortal, targetPortal });
 }
 
-void flow::FlowTile::cacheFlowMap(const Portal * resultStartPortal, const Portal * resultEndPortal, const TArray<flow::EikonalCellValue>& result)
+const TArray<EikonalCellValue>* flow::FlowTile::findFlowMap(const Portal * startPortal, const Portal * targetPortal) const
+{
+    return portalEikonalMaps.Find({ startPortal, targetPortal });
+}
+
+const TArray<EikonalCellValue>* flow::FlowTile::findTargetFlowMap(const TArray<FIntPoint>& targets) const
+{
+    return directEikonalMaps.Find(FlowTargetKey(targets));
+}
+
+void flow::FlowTile::cacheFlowMap(const Portal * resultStartPortal, const Portal * resultEndPortal, TArray<flow::EikonalCellValue>&& result)
+{
+    if (result.Num() != tileLength * tileLength) {
+        getFlowMapPool().release(MoveTemp(result));
+        return;
+    }
+    portalEikonalMaps.Add({ resultStartPortal, resultEndPortal }, MoveTemp(result));
+}
+
+void flow::FlowTile::cacheTargetFlowMap(const TArray<FIntPoint>& targets, TArray<flow::EikonalCellValue>&& result)
 {
     if (result.Num() != tileLength * tileLength) {
+        getFlowMapPool().release(MoveTemp(result));
         return;
     }
-    portalEikonalMaps.Add({ resultStartPortal, resultEndPortal }, result);
+    directEikonalMaps.Add(FlowTargetKey(targets), MoveTemp(result));
 }
 
 void flow::FlowTile::deleteAllFlowMaps()
 {
-    portalEikonalMaps.Empty();
+    countEvictedFlowMaps(portalEikonalMaps.Num());
+    getFlowMapPool().releaseAll(portalEikonalMaps);
+}
+
+void flow::FlowTile::setDiskCache(FlowMapDiskCache* cache)
+{
+    diskCache = cache;
+}
+
+bool flow::FlowTile::isResident() const
+{
+    return fixedTileData != nullptr || tileData.Num() > 0 || !compressedData.isEmpty();
+}
+
+void flow::FlowTile::pageOut(TArray<uint8>& outData)
+{
+    if (!compressedData.isEmpty()) {
+        compressedData.decode(outData);
+        compressedData.reset();
+    }
+    else {
+        outData = MoveTemp(tileData);
+    }
+    tileData.Empty();
+    countEvictedFlowMaps(getFlowMapCount());
+    getFlowMapPool().releaseAll(portalEikonalMaps);
+    getFlowMapPool().releaseAll(directEikonalMaps);
+}
+
+void flow::FlowTile::pageIn(TArray<uint8>&& data)
+{
+    check(data.Num() == tileLength * tileLength);
+    if (!CompressedTileData::compress(data, tileLength, compressedData)) {
+        tileData = MoveTemp(data);
+    }
 }
 
 void flow::FlowTile::invalidatedTile(const FlowTile& invalidTile)
 {
-    TArray<FlowPortalKey> invalidMapKeys;
-    for (auto& portal : invalidTile.portals) {
-        for (auto& pair : portalEikonalMaps) {
-            if (pair.Key.targetPortal == &portal) {
-                invalidMapKeys.Add(pair.Key);
-            }
+    int32 flowMapCount = portalEikonalMaps.Num();
+    for (auto it = portalEikonalMaps.CreateIterator(); it; ++it) {
+        if (it.Key().targetPortal->parentTile == &invalidTile) {
+            getFlowMapPool().release(MoveTemp(it.Value()));
+            it.RemoveCurrent();
         }
     }
-    for (auto& key : invalidMapKeys) {
-        portalEikonalMaps.Remove(key);
-    }
+    countEvictedFlowMaps(flowMapCount - portalEikonalMaps.Num());
 }
 
-bool flow::FlowTile::isCrossMoveAllowed(const FIntPoint& from, const FIntPoint& to) const
+bool flow::FlowTile::isCrossMoveAllowed(const TArray<uint8>& data, const FIntPoint& from, const FIntPoint& to) const
 {
     // we do not want to allow cross movements where two obstacles meet, because most likely a unit cannot move there.
     // For example, the move here from start S to target T would not be allowed:
@@ -505,7 +844,6 @@ bool flow::FlowTile::isCrossMoveAllowed(const FIntPoint& from, const FIntPoint&
     // . # T . 
     // . S # #
     // . . . . 
-    auto& data = getData();
     int32 deltaX = to.X - from.X;
     int32 deltaY = to.Y - from.Y;
     int32 index1 = toIndex(from + FIntPoint(deltaX, 0));
@@ -513,7 +851,7 @@ bool flow::FlowTile::isCrossMoveAllowed(const FIntPoint& from, const FIntPoint&
     return data[index1] != BLOCKED || data[index2] != BLOCKED;
 }
 
-void flow::FlowTile::initializeFrontier(const FIntPoint& frontier, TArray<bool>& initializedNodes, TArray<AStarNode>& nodes, const FIntPoint & goal, list<FIntPoint>& openNodes) const
+void flow::FlowTile::initializeFrontier(const TArray<uint8>& data, const FIntPoint& frontier, TArray<bool>& initializedNodes, TArray<AStarNode>& nodes, const FIntPoint & goal, list<FIntPoint>& openNodes) const
 {
     int32 frontierIndex = toIndex(frontier);
     nodes[frontierIndex].open = false;
@@ -521,63 +859,62 @@ void flow::FlowTile::initializeFrontier(const FIntPoint& frontier, TArray<bool>&
     // init north node
     if (frontier.Y > 0) {
         FIntPoint node = frontier + FIntPoint(0, -1);
-        initFrontierNode(node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
+        initFrontierNode(data, node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
     }
 
     // init north-west node
     if (frontier.Y > 0 && frontier.X > 0) {
         FIntPoint node = frontier + FIntPoint(-1, -1);
-        if (isCrossMoveAllowed(node, frontier)) {
-            initFrontierNode(node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
+        if (isCrossMoveAllowed(data, node, frontier)) {
+            initFrontierNode(data, node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
         }
     }
 
     // init west node
     if (frontier.X > 0) {
         FIntPoint node = frontier + FIntPoint(-1, 0);
-        initFrontierNode(node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
+        initFrontierNode(data, node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
     }
 
     // init south-west node
     if (frontier.X > 0 && frontier.Y < (tileLength - 1)) {
         FIntPoint node = frontier + FIntPoint(-1, 1);
-        if (isCrossMoveAllowed(node, frontier)) {
-            initFrontierNode(node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
+        if (isCrossMoveAllowed(data, node, frontier)) {
+            initFrontierNode(data, node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
         }
     }
 
     // init south node
     if (frontier.Y < (tileLength - 1)) {
         FIntPoint node = frontier + FIntPoint(0, 1);
-        initFrontierNode(node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
+        initFrontierNode(data, node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
     }
 
     // init south-east node
     if (frontier.Y < (tileLength - 1) && frontier.X < (tileLength - 1)) {
         FIntPoint node = frontier + FIntPoint(1, 1);
-        if (isCrossMoveAllowed(node, frontier)) {
-            initFrontierNode(node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
+        if (isCrossMoveAllowed(data, node, frontier)) {
+            initFrontierNode(data, node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
         }
     }
 
     // init east node
     if (frontier.X < (tileLength - 1)) {
         FIntPoint node = frontier + FIntPoint(1, 0);
-        initFrontierNode(node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
+        initFrontierNode(data, node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
     }
 
     // init north-east node
     if (frontier.X < (tileLength - 1) && frontier.Y > 0) {
         FIntPoint node = frontier + FIntPoint(1, -1);
-        if (isCrossMoveAllowed(node, frontier)) {
-            initFrontierNode(node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
+        if (isCrossMoveAllowed(data, node, frontier)) {
+            initFrontierNode(data, node, initializedNodes, nodes, frontierIndex, goal, frontier, openNodes);
         }
     }
 }
 
-void flow::FlowTile::initFrontierNode(const FIntPoint& node, TArray<bool> &initializedTiles, TArray<AStarNode> &nodes, int32 frontierIndex, const FIntPoint & goal, const FIntPoint& frontier, list<FIntPoint>& openNodes) const
+void flow::FlowTile::initFrontierNode(const TArray<uint8>& data, const FIntPoint& node, TArray<bool> &initializedTiles, TArray<AStarNode> &nodes, int32 frontierIndex, const FIntPoint & goal, const FIntPoint& frontier, list<FIntPoint>& openNodes) const
 {
-    auto& data = getData();
     int32 nodeIndex = toIndex(node);
     int32 pointCost = nodes[frontierIndex].pointCost + data[nodeIndex];
     int32 goalCost = pointCost + distance(node, goal);
@@ -602,17 +939,220 @@ void flow::FlowTile::initFrontierNode(const FIntPoint& node, TArray<bool> &initi
     }
 }
 
-const TArray<uint8>& flow::FlowTile::getData() const
+bool flow::FlowTile::updateCells(const TArray<uint8>& newData, TArray<uint8>* newFixedData, const TArray<int32>& changedCells, bool& connectionsChanged)
+{
+    TArray<uint8> scratch;
+    auto& oldData = getData(scratch);
+    int32 maxIndex = tileLength - 1;
+    for (int32 index : changedCells) {
+        int32 x = index % tileLength;
+        int32 y = index / tileLength;
+        bool isBorder = x == 0 || y == 0 || x == maxIndex || y == maxIndex;
+        if (isBorder && (oldData[index] == BLOCKED) != (newData[index] == BLOCKED)) {
+            // the portal windows are defined by the blocked border cells
+            return false;
+        }
+    }
+
+    fixedTileData = newFixedData;
+    if (fixedTileData != nullptr) {
+        tileData.Empty();
+        compressedData.reset();
+    }
+    else {
+        setOwnData(newData);
+    }
+
+    // the portal objects stay the same, so the connections to the neighbors and all pointers to the portals stay valid.
+    // only the connections inside the tile that can be affected by the changed cells are searched again
+    TArray<int32> portalRegions;
+    findPortalRegions(newData, portalRegions);
+    connectionsChanged = false;
+    for (int32 i = 0; i < portals.Num(); i++) {
+        for (int32 k = i + 1; k < portals.Num(); k++) {
+            auto portal = &portals[i];
+            auto otherPortal = &portals[k];
+            int32* cost = portal->connected.Find(otherPortal);
+            bool isConnected = portalRegions[i] == portalRegions[k];
+            if (cost != nullptr && isConnected && !isConnectionTouched(portal->center, otherPortal->center, *cost, changedCells)) {
+                continue;
+            }
+            PathSearchResult portalPath = isConnected ? findPath(portal->center, otherPortal->center) : PathSearchResult{ false, {}, 0 };
+            connectionsChanged |= (cost != nullptr) != portalPath.success;
+            if (portalPath.success) {
+                portal->connected.Add(otherPortal, portalPath.pathCost);
+                otherPortal->connected.Add(portal, portalPath.pathCost);
+            }
+            else {
+                portal->connected.Remove(otherPortal);
+                otherPortal->connected.Remove(portal);
+            }
+        }
+    }
+
+    // only the flowmaps that were solved over the changed cells are removed
+    int32 flowMapCount = getFlowMapCount();
+    for (auto it = portalEikonalMaps.CreateIterator(); it; ++it) {
+        if (isFlowMapTouched(it.Value(), changedCells)) {
+            getFlowMapPool().release(MoveTemp(it.Value()));
+            it.RemoveCurrent();
+        }
+    }
+    for (auto it = directEikonalMaps.CreateIterator(); it; ++it) {
+        if (isFlowMapTouched(it.Value(), changedCells)) {
+            getFlowMapPool().release(MoveTemp(it.Value()));
+            it.RemoveCurrent();
+        }
+    }
+    countEvictedFlowMaps(flowMapCount - getFlowMapCount());
+    return true;
+}
+
+void flow::FlowTile::findPortalRegions(const TArray<uint8>& data, TArray<int32>& portalRegions) const
+{
+    // flood fill the free cells, two portals are connected if their centers are in the same region
+    TArray<int32> regions;
+    regions.Init(INDEX_NONE, tileLength * tileLength);
+    int32 regionCount = 0;
+    TArray<FIntPoint> todo;
+    for (int32 start = 0; start < data.Num(); start++) {
+        if (data[start] == BLOCKED || regions[start] != INDEX_NONE) {
+            continue;
+        }
+        regions[start] = regionCount;
+        todo.Add(FIntPoint(start % tileLength, start / tileLength));
+        while (todo.Num() > 0) {
+            FIntPoint cell = todo.Pop(false);
+            for (FIntPoint next : { cell + FIntPoint(1, 0), cell - FIntPoint(1, 0), cell + FIntPoint(0, 1), cell - FIntPoint(0, 1) }) {
+                if (next.X < 0 || next.Y < 0 || next.X >= tileLength || next.Y >= tileLength) {
+                    continue;
+                }
+                int32 index = toIndex(next);
+                if (data[index] != BLOCKED && regions[index] == INDEX_NONE) {
+                    regions[index] = regionCount;
+                    todo.Add(next);
+                }
+            }
+        }
+        regionCount++;
+    }
+    portalRegions.SetNum(portals.Num());
+    for (int32 i = 0; i < portals.Num(); i++) {
+        portalRegions[i] = regions[toIndex(portals[i].center)];
+    }
+}
+
+bool flow::FlowTile::isConnectionTouched(const FIntPoint& from, const FIntPoint& to, int32 cost, const TArray<int32>& changedCells) const
+{
+    // every cell costs at least 1, so a path over the cell costs more than the diagonal distances to it.
+    // cells outside of that bound are neither on the current path nor can they lead to a cheaper one
+    for (int32 index : changedCells) {
+        FIntPoint cell(index % tileLength, index / tileLength);
+        FIntPoint toCell = cell - from;
+        FIntPoint fromCell = to - cell;
+        int32 steps = FMath::Max(FMath::Abs(toCell.X), FMath::Abs(toCell.Y)) + FMath::Max(FMath::Abs(fromCell.X), FMath::Abs(fromCell.Y));
+        if (steps < cost) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool flow::FlowTile::isFlowMapTouched(const TArray<EikonalCellValue>& flowMap, const TArray<int32>& changedCells) const
+{
+    // a cell influences the flowmap if it or one of its neighbors was reached by the solver
+    for (int32 index : changedCells) {
+        FIntPoint cell(index % tileLength, index / tileLength);
+        for (int32 i = -1; i < 8; i++) {
+            FIntPoint p = i < 0 ? cell : cell + neighbors[i];
+            if (p.X < 0 || p.Y < 0 || p.X >= tileLength || p.Y >= tileLength) {
+                continue;
+            }
+            if (flowMap[toIndex(p)].cellValue < MAX_VAL) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void flow::FlowTile::invalidateLookaheadFlowMaps(const FIntPoint& changedTile)
+{
+    for (auto it = portalEikonalMaps.CreateIterator(); it; ++it) {
+        auto delta = it.Key().connectedPortal->tileCoordinates - coordinates;
+        if (delta.SizeSquared() != 2) {
+            continue;
+        }
+        auto changedDelta = changedTile - coordinates;
+        if (changedDelta == delta || changedDelta == FIntPoint(delta.X, 0) || changedDelta == FIntPoint(0, delta.Y)) {
+            getFlowMapPool().release(MoveTemp(it.Value()));
+            it.RemoveCurrent();
+            countEvictedFlowMaps(1);
+        }
+    }
+}
+
+void flow::FlowTile::setOwnData(const TArray<uint8>& data)
+{
+    if (CompressedTileData::compress(data, tileLength, compressedData)) {
+        tileData.Empty();
+    }
+    else {
+        tileData = data;
+    }
+}
+
+const TArray<uint8>& flow::FlowTile::getData(TArray<uint8>& scratch) const
 {
     if (fixedTileData != nullptr) {
         return *fixedTileData;
     }
+    if (!compressedData.isEmpty()) {
+        compressedData.decode(scratch);
+        return scratch;
+    }
     return tileData;
 }
 
+void flow::FlowTile::copyData(TArray<uint8>& result) const
+{
+    if (!compressedData.isEmpty()) {
+        compressedData.decode(result);
+    }
+    else {
+        result = fixedTileData != nullptr ? *fixedTileData : tileData;
+    }
+}
+
 uint8 flow::FlowTile::getData(FIntPoint coordinates) const
 {
-    return getData()[toIndex(coordinates)];
+    if (fixedTileData != nullptr) {
+        return (*fixedTileData)[toIndex(coordinates)];
+    }
+    if (!compressedData.isEmpty()) {
+        return compressedData.getCell(coordinates.X, coordinates.Y);
+    }
+    return tileData[toIndex(coordinates)];
+}
+
+void flow::FlowTile::copyRow(int32 y, uint8* result) const
+{
+    if (!compressedData.isEmpty()) {
+        compressedData.decodeRow(y, result);
+        return;
+    }
+    auto& data = fixedTileData != nullptr ? *fixedTileData : tileData;
+    FMemory::Memcpy(result, &data[y * tileLength], tileLength);
+}
+
+bool flow::FlowTile::isCompressed() const
+{
+    return !compressedData.isEmpty();
+}
+
+bool flow::FlowTile::hasOwnData() const
+{
+    return fixedTileData == nullptr;
 }
 
 int32 flow::toFourTileIndex(bool isRight, bool isDown, int32 x, int32 y, int32 tileLength)
@@ -6,14 +6,15 @@
 
 #include "CoreMinimal.h"
 #include "Portal.h"
+#include "CompressedTileData.h"
+#include "Counters.h"
 #include <functional>
 #include <list>
 
-//For UE4 Profiler ~ Stat Group
-DECLARE_STATS_GROUP(TEXT("FlowPath"), STATGROUP_FlowPath, STATCAT_Advanced);
-
 namespace flow {
 
+    class FlowMapDiskCache;
+
     struct AStarNode {
         int32 pointCost;
         int32 goalCost;
@@ -80,27 +81,49 @@ namespace flow {
     struct EikonalCellValue {
         int8 directionLookupIndex;
         float cellValue;
+
+        friend FArchive& operator<<(FArchive& Ar, EikonalCellValue& Value)
+        {
+            return Ar << Value.directionLookupIndex << Value.cellValue;
+        }
     };
 
+    /** The tile and portal index of a portal in baked navigation data. */
+    typedef TPair<int32, int32> BakedPortalIndex;
+
     class FlowTile {
     private:
         TArray<uint8> tileData;
         TArray<uint8>* fixedTileData;
+        // tiles with large uniform regions keep their own data run-length encoded instead of in tileData
+        CompressedTileData compressedData;
         FIntPoint coordinates;
         int32 tileLength;
         TArray<Portal> portals;
         TMap<FlowPortalKey, TArray<EikonalCellValue>> portalEikonalMaps;
         TMap<FlowTargetKey, TArray<EikonalCellValue>> directEikonalMaps;
+        FlowMapDiskCache* diskCache = nullptr;
 
         void initPortalData();
 
         static int32 distance(FIntPoint p1, FIntPoint p2);
 
-        void initializeFrontier(const FIntPoint& frontier, TArray<bool>& initializedNodes, TArray<AStarNode>& tiles, const FIntPoint& goal, std::list<FIntPoint>& openNodes) const;
+        /** Stores the own cell data, compressed if that needs less memory. */
+        void setOwnData(const TArray<uint8>& data);
+
+        void initializeFrontier(const TArray<uint8>& data, const FIntPoint& frontier, TArray<bool>& initializedNodes, TArray<AStarNode>& tiles, const FIntPoint& goal, std::list<FIntPoint>& openNodes) const;
 
-        void initFrontierNode(const FIntPoint& tile, TArray<bool> &initializedNodes, TArray<AStarNode> &nodes, int32 frontierIndex, const FIntPoint & goal, const FIntPoint& frontier, std::list<FIntPoint>& openNodes) const;
+        void initFrontierNode(const TArray<uint8>& data, const FIntPoint& tile, TArray<bool> &initializedNodes, TArray<AStarNode> &nodes, int32 frontierIndex, const FIntPoint & goal, const FIntPoint& frontier, std::list<FIntPoint>& openNodes) const;
         
-        bool isCrossMoveAllowed(const FIntPoint& from, const FIntPoint& to) const;
+        bool isCrossMoveAllowed(const TArray<uint8>& data, const FIntPoint& from, const FIntPoint& to) const;
+
+        bool isFlowMapTouched(const TArray<EikonalCellValue>& flowMap, const TArray<int32>& changedCells) const;
+
+        /** Assigns every portal the index of the connected free region of its center cell. */
+        void findPortalRegions(const TArray<uint8>& data, TArray<int32>& portalRegions) const;
+
+        /** Returns true if one of the changed cells can lie on the cheapest path of the connection or make it cheaper. */
+        bool isConnectionTouched(const FIntPoint& from, const FIntPoint& to, int32 cost, const TArray<int32>& changedCells) const;
 
     public:
 
@@ -112,14 +135,56 @@ namespace flow {
 
         const FIntPoint& getCoordinates() const;
 
-        const TArray<uint8>& getData() const;
+        /**
+        * Returns the cell data without copying it. Compressed data is decoded into the scratch buffer, which is returned then.
+        * The result is only valid until the cell data of the tile changes.
+        */
+        const TArray<uint8>& getData(TArray<uint8>& scratch) const;
+
+        /** Copies the cell data into the result, compressed data is decoded. */
+        void copyData(TArray<uint8>& result) const;
 
         uint8 getData(FIntPoint coordinates) const;
 
+        /** Copies one row of the cell data without decoding the whole tile. */
+        void copyRow(int32 y, uint8* result) const;
+
+        bool isCompressed() const;
+
+        /** Returns false if the tile uses the shared data of empty or full tiles, which is never paged out. */
+        bool hasOwnData() const;
+
         explicit FlowTile(const TArray<uint8> &tileData, int32 tileLength, FIntPoint coordinates);
 
         explicit FlowTile(TArray<uint8>* fixedTileData, int32 tileLength, FIntPoint coordinates);
 
+        /** Reads the cell data and portal geometry written by writeBake, the portals are not searched again. Sets the error flag of the archive if the data is invalid. */
+        explicit FlowTile(FArchive& ar, TArray<uint8>* emptyData, TArray<uint8>* fullData, int32 tileLength, FIntPoint coordinates);
+
+        /** Returns the buffers of the flowmaps to the flowmap pool. */
+        ~FlowTile();
+
+        /** Tiles are allocated from a pool, so a rebuilt tile reuses the memory of the tile it replaces. */
+        static void* operator new(size_t size);
+
+        static void operator delete(void* tile);
+
+        /** Returns the bytes of the freed tiles that wait in the pool. */
+        static SIZE_T getPooledSize();
+
+        /** Writes the cell data and portal geometry. The cell data has to be resident. */
+        void writeBake(FArchive& ar, const TArray<uint8>* emptyData, const TArray<uint8>* fullData) const;
+
+        /** Writes the connections and costs of all portals, other portals are referenced by their baked index. */
+        void writeBakedConnections(FArchive& ar, TFunctionRef<BakedPortalIndex(const Portal*)> indexOf) const;
+
+        bool readBakedConnections(FArchive& ar, TFunctionRef<Portal*(const BakedPortalIndex&)> findPortal);
+
+        /** Writes all cached flowmaps whose portals are known to the index lookup. */
+        void writeBakedFlowMaps(FArchive& ar, TFunctionRef<BakedPortalIndex(const Portal*)> indexOf) const;
+
+        bool readBakedFlowMaps(FArchive& ar, TFunctionRef<Portal*(const BakedPortalIndex&)> findPortal);
+
         TArray<int32> getPortalsIndicesFor(int32 x, int32 y) const;
 
         void connectOverlappingPortals(FlowTile &tile, Orientation side);
@@ -138,12 +203,43 @@ namespace flow {
 
         TArray<TArray<EikonalCellValue>> getAllFlowMaps() const;
 
+        int32 getFlowMapCount() const;
+
+        /** Returns the bytes used by the cached flowmaps. */
+        SIZE_T getFlowMapsSize() const;
+
         bool hasFlowMap(const Portal* startPortal, const Portal* targetPortal) const;
 
-        void cacheFlowMap(const Portal * resultStartPortal, const Portal * resultEndPortal, const TArray<flow::EikonalCellValue>& result);
+        const TArray<EikonalCellValue>* findFlowMap(const Portal* startPortal, const Portal* targetPortal) const;
+
+        const TArray<EikonalCellValue>* findTargetFlowMap(const TArray<FIntPoint>& targets) const;
+
+        void cacheFlowMap(const Portal * resultStartPortal, const Portal * resultEndPortal, TArray<flow::EikonalCellValue>&& result);
+
+        void cacheTargetFlowMap(const TArray<FIntPoint>& targets, TArray<flow::EikonalCellValue>&& result);
 
         void deleteAllFlowMaps();
 
         void invalidatedTile(const FlowTile& invalidTile);
+
+        /**
+        * Replaces the cell data while keeping the portal objects. Only the connections between the portals inside the tile whose path can cross the changed cells are searched again.
+        * Returns false without changing anything if the portal windows would change. The new fixed data is used instead of a copy if it is not null.
+        */
+        bool updateCells(const TArray<uint8>& newData, TArray<uint8>* newFixedData, const TArray<int32>& changedCells, bool& connectionsChanged);
+
+        /** Removes the lookahead flowmaps whose 2x2 tile block contains the changed tile. */
+        void invalidateLookaheadFlowMaps(const FIntPoint& changedTile);
+
+        /** Solved flowmaps are read from and written to the disk cache. The cache can be null. */
+        void setDiskCache(FlowMapDiskCache* cache);
+
+        /** Returns false if the cell data is paged out. The portals and their connections are always available. */
+        bool isResident() const;
+
+        /** Moves the cell data out of the tile and removes all flowmaps. Tiles with shared data only drop their flowmaps. */
+        void pageOut(TArray<uint8>& outData);
+
+        void pageIn(TArray<uint8>&& data);
     };
 }
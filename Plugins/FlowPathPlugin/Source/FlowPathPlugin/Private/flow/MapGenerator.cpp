@@ -0,0 +1,210 @@
+//
+// Synthetic cost maps for benchmarks.
+//
+
+#include "MapGenerator.h"
+#include "EikonalSolver.h"
+
+using namespace flow;
+
+TArray<uint8> MapGenerator::generate(MapType type, int32 width, int32 height, int32 seed)
+{
+    TArray<uint8> map;
+    map.Init(EMPTY, width * height);
+    FRandomStream random(seed);
+    switch (type) {
+    case MapType::OpenField: generateOpenField(map, width, height, random); break;
+    case MapType::Maze: generateMaze(map, width, height, random); break;
+    case MapType::CityBlocks: generateCityBlocks(map, width, height, random); break;
+    case MapType::NoiseTerrain: generateNoiseTerrain(map, width, height, random); break;
+    case MapType::Chokepoints: generateChokepoints(map, width, height, random); break;
+    }
+    return map;
+}
+
+const TCHAR* MapGenerator::getName(MapType type)
+{
+    switch (type) {
+    case MapType::OpenField: return TEXT("openField");
+    case MapType::Maze: return TEXT("maze");
+    case MapType::CityBlocks: return TEXT("cityBlocks");
+    case MapType::NoiseTerrain: return TEXT("noiseTerrain");
+    case MapType::Chokepoints: return TEXT("chokepoints");
+    }
+    return TEXT("unknown");
+}
+
+TArray<uint8> MapGenerator::getTileData(const TArray<uint8>& map, int32 width, const FIntPoint& tileCoordinates, int32 tileLength)
+{
+    TArray<uint8> result;
+    result.AddUninitialized(tileLength * tileLength);
+    for (int32 y = 0; y < tileLength; y++) {
+        int32 mapIndex = tileCoordinates.X * tileLength + (tileCoordinates.Y * tileLength + y) * width;
+        FMemory::Memcpy(&result[y * tileLength], &map[mapIndex], tileLength);
+    }
+    return result;
+}
+
+void MapGenerator::generateOpenField(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random)
+{
+    for (auto& cell : map) {
+        float value = random.FRand();
+        if (value < 0.03f) {
+            cell = BLOCKED;
+        }
+        else if (value < 0.13f) {
+            cell = random.RandRange(2, 4);
+        }
+    }
+}
+
+void MapGenerator::generateMaze(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random)
+{
+    // every maze cell is a 2x2 corridor with a wall on its right and bottom side
+    const int32 pitch = 3;
+    int32 gridWidth = width / pitch;
+    int32 gridHeight = height / pitch;
+    for (auto& cell : map) {
+        cell = BLOCKED;
+    }
+    if (gridWidth == 0 || gridHeight == 0) {
+        return;
+    }
+
+    auto carve = [&](int32 x, int32 y, int32 sizeX, int32 sizeY) {
+        for (int32 j = y; j < y + sizeY; j++) {
+            for (int32 i = x; i < x + sizeX; i++) {
+                map[i + j * width] = EMPTY;
+            }
+        }
+    };
+
+    // iterative depth first search, so large mazes do not overflow the stack
+    TArray<bool> visited;
+    visited.AddZeroed(gridWidth * gridHeight);
+    TArray<FIntPoint> stack;
+    stack.Add(FIntPoint(0, 0));
+    visited[0] = true;
+    carve(0, 0, 2, 2);
+    while (stack.Num() > 0) {
+        FIntPoint current = stack.Last();
+        FIntPoint candidates[4];
+        int32 candidateCount = 0;
+        const FIntPoint directions[] = { FIntPoint(1, 0), FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(0, -1) };
+        for (auto& direction : directions) {
+            FIntPoint next = current + direction;
+            if (next.X >= 0 && next.Y >= 0 && next.X < gridWidth && next.Y < gridHeight && !visited[next.X + next.Y * gridWidth]) {
+                candidates[candidateCount++] = next;
+            }
+        }
+        if (candidateCount == 0) {
+            stack.Pop(false);
+            continue;
+        }
+
+        FIntPoint next = candidates[random.RandRange(0, candidateCount - 1)];
+        visited[next.X + next.Y * gridWidth] = true;
+        carve(next.X * pitch, next.Y * pitch, 2, 2);
+        // remove the wall between both cells
+        FIntPoint wallCell = FIntPoint(FMath::Min(current.X, next.X), FMath::Min(current.Y, next.Y)) * pitch;
+        if (next.X != current.X) {
+            carve(wallCell.X + 2, wallCell.Y, 1, 2);
+        }
+        else {
+            carve(wallCell.X, wallCell.Y + 2, 2, 1);
+        }
+        stack.Add(next);
+    }
+}
+
+void MapGenerator::generateCityBlocks(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random)
+{
+    const int32 pitch = 16;
+    const int32 streetWidth = 3;
+    int32 blocksX = FMath::DivideAndRoundUp(width, pitch);
+    int32 blocksY = FMath::DivideAndRoundUp(height, pitch);
+    TArray<bool> parks;
+    for (int32 i = 0; i < blocksX * blocksY; i++) {
+        parks.Add(random.FRand() < 0.25f);
+    }
+
+    for (int32 y = 0; y < height; y++) {
+        for (int32 x = 0; x < width; x++) {
+            int32 inBlockX = x % pitch;
+            int32 inBlockY = y % pitch;
+            if (inBlockX < streetWidth || inBlockY < streetWidth) {
+                continue;
+            }
+            bool isPark = parks[x / pitch + (y / pitch) * blocksX];
+            bool isSidewalk = inBlockX == streetWidth || inBlockY == streetWidth || inBlockX == pitch - 1 || inBlockY == pitch - 1;
+            map[x + y * width] = isPark ? 3 : (isSidewalk ? 2 : BLOCKED);
+        }
+    }
+}
+
+void MapGenerator::generateNoiseTerrain(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random)
+{
+    // two octaves of value noise
+    const int32 spacings[] = { 16, 4 };
+    const float weights[] = { 0.65f, 0.35f };
+    TArray<float> noise;
+    noise.AddZeroed(width * height);
+    for (int32 octave = 0; octave < 2; octave++) {
+        int32 spacing = spacings[octave];
+        int32 latticeWidth = width / spacing + 2;
+        int32 latticeHeight = height / spacing + 2;
+        TArray<float> lattice;
+        for (int32 i = 0; i < latticeWidth * latticeHeight; i++) {
+            lattice.Add(random.FRand());
+        }
+        for (int32 y = 0; y < height; y++) {
+            for (int32 x = 0; x < width; x++) {
+                int32 lx = x / spacing;
+                int32 ly = y / spacing;
+                float fx = FMath::SmoothStep(0.0f, 1.0f, (x % spacing) / float(spacing));
+                float fy = FMath::SmoothStep(0.0f, 1.0f, (y % spacing) / float(spacing));
+                float top = FMath::Lerp(lattice[lx + ly * latticeWidth], lattice[lx + 1 + ly * latticeWidth], fx);
+                float bottom = FMath::Lerp(lattice[lx + (ly + 1) * latticeWidth], lattice[lx + 1 + (ly + 1) * latticeWidth], fx);
+                noise[x + y * width] += FMath::Lerp(top, bottom, fy) * weights[octave];
+            }
+        }
+    }
+
+    for (int32 i = 0; i < map.Num(); i++) {
+        map[i] = noise[i] > 0.72f ? BLOCKED : 1 + FMath::FloorToInt(noise[i] * 6);
+    }
+}
+
+void MapGenerator::generateChokepoints(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random)
+{
+    // square rooms with walls on their right and bottom side, each wall has one door that is two cells wide
+    const int32 pitch = 32;
+    const int32 doorWidth = 2;
+    for (int32 y = 0; y < height; y++) {
+        for (int32 x = 0; x < width; x++) {
+            if (x % pitch == pitch - 1 || y % pitch == pitch - 1) {
+                map[x + y * width] = BLOCKED;
+            }
+        }
+    }
+    for (int32 roomY = 0; roomY * pitch < height; roomY++) {
+        for (int32 roomX = 0; roomX * pitch < width; roomX++) {
+            int32 rightWall = roomX * pitch + pitch - 1;
+            int32 bottomWall = roomY * pitch + pitch - 1;
+            int32 door = random.RandRange(0, pitch - 1 - doorWidth);
+            for (int32 i = door; i < door + doorWidth; i++) {
+                int32 y = roomY * pitch + i;
+                if (rightWall < width && y < height) {
+                    map[rightWall + y * width] = EMPTY;
+                }
+            }
+            door = random.RandRange(0, pitch - 1 - doorWidth);
+            for (int32 i = door; i < door + doorWidth; i++) {
+                int32 x = roomX * pitch + i;
+                if (bottomWall < height && x < width) {
+                    map[x + bottomWall * width] = EMPTY;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Synthetic cost maps for benchmarks.
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace flow {
+
+    enum class MapType : uint8 {
+        // mostly empty with scattered obstacles and cost variations
+        OpenField,
+        // a perfect maze with two cell wide corridors
+        Maze,
+        // a street grid with buildings and parks between the streets
+        CityBlocks,
+        // smooth terrain costs with blocked peaks
+        NoiseTerrain,
+        // rooms that are only connected through narrow doors
+        Chokepoints
+    };
+
+    const MapType allMapTypes[] = { MapType::OpenField, MapType::Maze, MapType::CityBlocks, MapType::NoiseTerrain, MapType::Chokepoints };
+
+    /** Creates reproducible cost maps. A map has width * height cells in row order and only contains valid cell costs. */
+    class MapGenerator {
+    private:
+        static void generateOpenField(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random);
+
+        static void generateMaze(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random);
+
+        static void generateCityBlocks(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random);
+
+        static void generateNoiseTerrain(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random);
+
+        static void generateChokepoints(TArray<uint8>& map, int32 width, int32 height, FRandomStream& random);
+
+    public:
+        static TArray<uint8> generate(MapType type, int32 width, int32 height, int32 seed);
+
+        static const TCHAR* getName(MapType type);
+
+        /** Copies the cells of one tile out of the map. The map width has to be a multiple of the tile length. */
+        static TArray<uint8> getTileData(const TArray<uint8>& map, int32 width, const FIntPoint& tileCoordinates, int32 tileLength);
+    };
+}
@@ -0,0 +1,120 @@
+//
+// Dense per-tile occupancy and reservation layers used for the agent collision checks.
+//
+
+#include "OccupancyGrid.h"
+
+using namespace flow;
+
+OccupancyGrid::OccupancyGrid(int32 tileLength) : tileLength(tileLength), touchedCount(0) {
+}
+
+OccupancyGrid::Layer* OccupancyGrid::findLayer(const TilePoint& p) const
+{
+    if (p.pointInTile.X < 0 || p.pointInTile.Y < 0 || p.pointInTile.X >= tileLength || p.pointInTile.Y >= tileLength) {
+        return nullptr;
+    }
+    return layers.find(p.tileLocation);
+}
+
+void OccupancyGrid::touch(Layer* layer, int32 index)
+{
+    int32 slot = FPlatformAtomics::InterlockedIncrement(&touchedCount) - 1;
+    if (slot < touchedCells.Num()) {
+        touchedCells[slot] = { layer, index };
+    }
+}
+
+void OccupancyGrid::clearLayer(Layer& layer)
+{
+    FMemory::Memzero(layer.blocked.GetData(), layer.blocked.Num() * sizeof(int64));
+    for (auto& reservation : layer.reservations) {
+        reservation = INDEX_NONE;
+    }
+}
+
+void OccupancyGrid::addTile(const FIntPoint& tileCoordinates)
+{
+    if (layers.contains(tileCoordinates)) {
+        return;
+    }
+    int32 size = tileLength * tileLength;
+    auto layer = MakeUnique<Layer>();
+    layer->coordinates = tileCoordinates;
+    layer->blocked.AddZeroed(FMath::DivideAndRoundUp(size, 64));
+    layer->reservations.Init(INDEX_NONE, size);
+    layers.add(MoveTemp(layer));
+}
+
+void OccupancyGrid::reset(int32 maxWrites)
+{
+    if (touchedCount > touchedCells.Num()) {
+        // more cells were written than tracked, so everything has to be cleared
+        for (auto& layer : layers.getTiles()) {
+            clearLayer(*layer);
+        }
+    }
+    else {
+        for (int32 i = 0; i < touchedCount; i++) {
+            auto& cell = touchedCells[i];
+            cell.layer->blocked[cell.index / 64] = 0;
+            cell.layer->reservations[cell.index] = INDEX_NONE;
+        }
+    }
+    touchedCount = 0;
+    touchedCells.SetNumUninitialized(maxWrites, false);
+}
+
+void OccupancyGrid::block(const TilePoint& p)
+{
+    auto layer = findLayer(p);
+    if (layer == nullptr) {
+        return;
+    }
+    int32 index = p.pointInTile.X + p.pointInTile.Y * tileLength;
+    volatile int64* word = &layer->blocked[index / 64];
+    int64 bit = int64(1) << (index % 64);
+    int64 current = *word;
+    while (!(current & bit)) {
+        int64 previous = FPlatformAtomics::InterlockedCompareExchange(word, current | bit, current);
+        if (previous == current) {
+            touch(layer, index);
+            return;
+        }
+        current = previous;
+    }
+}
+
+bool OccupancyGrid::isBlocked(const TilePoint& p) const
+{
+    auto layer = findLayer(p);
+    if (layer == nullptr) {
+        return false;
+    }
+    int32 index = p.pointInTile.X + p.pointInTile.Y * tileLength;
+    return (layer->blocked[index / 64] & (int64(1) << (index % 64))) != 0;
+}
+
+bool OccupancyGrid::reserve(const TilePoint& p, int32 agentIndex)
+{
+    auto layer = findLayer(p);
+    if (layer == nullptr) {
+        return false;
+    }
+    int32 index = p.pointInTile.X + p.pointInTile.Y * tileLength;
+    int32 previous = FPlatformAtomics::InterlockedCompareExchange(&layer->reservations[index], agentIndex, INDEX_NONE);
+    if (previous == INDEX_NONE) {
+        touch(layer, index);
+        return true;
+    }
+    return previous == agentIndex;
+}
+
+int32 OccupancyGrid::getReservation(const TilePoint& p) const
+{
+    auto layer = findLayer(p);
+    if (layer == nullptr) {
+        return INDEX_NONE;
+    }
+    return layer->reservations[p.pointInTile.X + p.pointInTile.Y * tileLength];
+}
@@ -0,0 +1,71 @@
+//
+// Dense per-tile occupancy and reservation layers used for the agent collision checks.
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowPath.h"
+#include "TileGrid.h"
+
+namespace flow {
+
+    /**
+    * Stores which cells are blocked by an agent and which agent has reserved a cell for its next move.
+    * Blocking and reserving is lock free and can be done from the parallel agent update, adding tiles is only allowed between ticks.
+    * The layers are found through the same chunked grid as the tiles, so no cell access hashes the coordinates.
+    * A replaced tile keeps the layer of its coordinates.
+    */
+    class OccupancyGrid {
+    private:
+        struct Layer {
+            FIntPoint coordinates;
+            // one bit per cell
+            TArray<int64> blocked;
+            // the agent index that reserved the cell, or INDEX_NONE
+            TArray<int32> reservations;
+
+            const FIntPoint& getCoordinates() const
+            {
+                return coordinates;
+            }
+        };
+
+        struct TouchedCell {
+            Layer* layer;
+            int32 index;
+        };
+
+        int32 tileLength;
+        TileGrid<Layer> layers;
+
+        // the cells written since the last reset, so only those have to be cleared
+        TArray<TouchedCell> touchedCells;
+        volatile int32 touchedCount;
+
+        Layer* findLayer(const TilePoint& p) const;
+
+        void touch(Layer* layer, int32 index);
+
+        static void clearLayer(Layer& layer);
+
+    public:
+        explicit OccupancyGrid(int32 tileLength);
+
+        void addTile(const FIntPoint& tileCoordinates);
+
+        /** Clears all cells that were written since the last reset and prepares the touched cell list for the given number of writes. */
+        void reset(int32 maxWrites);
+
+        /** Marks the cell as blocked. Thread safe. */
+        void block(const TilePoint& p);
+
+        bool isBlocked(const TilePoint& p) const;
+
+        /** Tries to reserve the cell for the agent. Returns true if the cell is now reserved by that agent. Thread safe. */
+        bool reserve(const TilePoint& p, int32 agentIndex);
+
+        /** Returns the agent that reserved the cell or INDEX_NONE. */
+        int32 getReservation(const TilePoint& p) const;
+    };
+}
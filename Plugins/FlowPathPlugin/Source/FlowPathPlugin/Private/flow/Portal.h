@@ -18,7 +18,8 @@ namespace flow {
         FIntPoint end;
         FIntPoint center;
         Orientation orientation;
-        TMap<Portal *, int32> connected;
+        // most portals have only a few connections, those are stored inside the portal to keep the portal graph in the tile's portal array
+        TMap<Portal *, int32, TInlineSetAllocator<8>> connected;
         FlowTile *parentTile;
         FIntPoint tileCoordinates;
 
@@ -0,0 +1,166 @@
+//
+// Dense chunked grid that owns the tiles and finds them by their coordinates.
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace flow {
+
+    /**
+    * Owns the tiles and finds them with arithmetic instead of hashing the coordinates.
+    * The grid is split into chunks of 16x16 tiles and only the chunks that contain tiles are allocated, so maps with distant islands stay small.
+    * The chunk directory covers the bounding box of the allocated chunks and grows when a tile is added outside of it.
+    * The tile type has to provide its coordinates with getCoordinates().
+    */
+    template<typename TileType>
+    class TileGrid {
+    public:
+        static const int32 ChunkShift = 4;
+        static const int32 ChunkLength = 1 << ChunkShift;
+
+    private:
+        struct Chunk {
+            // the index of the tile in the tile array, or INDEX_NONE
+            int32 slots[ChunkLength * ChunkLength];
+            int32 tileCount = 0;
+
+            Chunk()
+            {
+                for (auto& slot : slots) {
+                    slot = INDEX_NONE;
+                }
+            }
+        };
+
+        // the tiles are kept contiguous for iteration, removing a tile moves the last one into its place
+        TArray<TUniquePtr<TileType>> tiles;
+        TArray<TUniquePtr<Chunk>> chunks;
+        FIntPoint chunkOrigin = FIntPoint::ZeroValue;
+        FIntPoint chunkExtent = FIntPoint::ZeroValue;
+
+        Chunk* findChunk(const FIntPoint& coord) const
+        {
+            // the arithmetic shift rounds down, so negative coordinates work the same way
+            int32 x = (coord.X >> ChunkShift) - chunkOrigin.X;
+            int32 y = (coord.Y >> ChunkShift) - chunkOrigin.Y;
+            if (x < 0 || y < 0 || x >= chunkExtent.X || y >= chunkExtent.Y) {
+                return nullptr;
+            }
+            return chunks[x + y * chunkExtent.X].Get();
+        }
+
+        static int32 toSlotIndex(const FIntPoint& coord)
+        {
+            return (coord.X & (ChunkLength - 1)) + (coord.Y & (ChunkLength - 1)) * ChunkLength;
+        }
+
+        Chunk& addChunk(const FIntPoint& coord)
+        {
+            FIntPoint chunkCoord(coord.X >> ChunkShift, coord.Y >> ChunkShift);
+            FIntPoint chunkEnd = chunkOrigin + chunkExtent;
+            if (chunkExtent == FIntPoint::ZeroValue || chunkCoord.X < chunkOrigin.X || chunkCoord.Y < chunkOrigin.Y || chunkCoord.X >= chunkEnd.X || chunkCoord.Y >= chunkEnd.Y) {
+                // grow the directory to the new bounding box, only the chunk pointers are moved
+                FIntPoint newOrigin = chunkExtent == FIntPoint::ZeroValue ? chunkCoord : chunkOrigin.ComponentMin(chunkCoord);
+                FIntPoint newEnd = chunkExtent == FIntPoint::ZeroValue ? chunkCoord + FIntPoint(1, 1) : chunkEnd.ComponentMax(chunkCoord + FIntPoint(1, 1));
+                FIntPoint newExtent = newEnd - newOrigin;
+                TArray<TUniquePtr<Chunk>> newChunks;
+                newChunks.SetNum(newExtent.X * newExtent.Y);
+                for (int32 y = 0; y < chunkExtent.Y; y++) {
+                    for (int32 x = 0; x < chunkExtent.X; x++) {
+                        int32 newIndex = (x + chunkOrigin.X - newOrigin.X) + (y + chunkOrigin.Y - newOrigin.Y) * newExtent.X;
+                        newChunks[newIndex] = MoveTemp(chunks[x + y * chunkExtent.X]);
+                    }
+                }
+                chunks = MoveTemp(newChunks);
+                chunkOrigin = newOrigin;
+                chunkExtent = newExtent;
+            }
+
+            auto& chunk = chunks[(chunkCoord.X - chunkOrigin.X) + (chunkCoord.Y - chunkOrigin.Y) * chunkExtent.X];
+            if (!chunk.IsValid()) {
+                chunk = MakeUnique<Chunk>();
+            }
+            return *chunk;
+        }
+
+    public:
+        TileType* find(const FIntPoint& coord) const
+        {
+            auto chunk = findChunk(coord);
+            if (chunk == nullptr) {
+                return nullptr;
+            }
+            int32 index = chunk->slots[toSlotIndex(coord)];
+            return index != INDEX_NONE ? tiles[index].Get() : nullptr;
+        }
+
+        bool contains(const FIntPoint& coord) const
+        {
+            return find(coord) != nullptr;
+        }
+
+        /** Adds the tile at its coordinates and returns the tile it replaced, if any. */
+        TUniquePtr<TileType> add(TUniquePtr<TileType> tile)
+        {
+            FIntPoint coord = tile->getCoordinates();
+            auto& chunk = addChunk(coord);
+            int32& slot = chunk.slots[toSlotIndex(coord)];
+            if (slot != INDEX_NONE) {
+                TUniquePtr<TileType> replacedTile = MoveTemp(tiles[slot]);
+                tiles[slot] = MoveTemp(tile);
+                return replacedTile;
+            }
+            slot = tiles.Add(MoveTemp(tile));
+            chunk.tileCount++;
+            return nullptr;
+        }
+
+        /** Removes the tile and returns it, or null if there is no tile at the coordinates. */
+        TUniquePtr<TileType> remove(const FIntPoint& coord)
+        {
+            auto chunk = findChunk(coord);
+            if (chunk == nullptr || chunk->slots[toSlotIndex(coord)] == INDEX_NONE) {
+                return nullptr;
+            }
+            int32& slot = chunk->slots[toSlotIndex(coord)];
+            int32 index = slot;
+            slot = INDEX_NONE;
+
+            TUniquePtr<TileType> removedTile = MoveTemp(tiles[index]);
+            tiles.RemoveAtSwap(index, 1, false);
+            if (index < tiles.Num()) {
+                // the last tile was moved into the free index
+                FIntPoint movedCoord = tiles[index]->getCoordinates();
+                findChunk(movedCoord)->slots[toSlotIndex(movedCoord)] = index;
+            }
+
+            if (--chunk->tileCount == 0) {
+                // the directory keeps its size, only the empty chunk is released
+                FIntPoint chunkCoord(coord.X >> ChunkShift, coord.Y >> ChunkShift);
+                chunks[(chunkCoord.X - chunkOrigin.X) + (chunkCoord.Y - chunkOrigin.Y) * chunkExtent.X].Reset();
+            }
+            return removedTile;
+        }
+
+        void empty()
+        {
+            tiles.Empty();
+            chunks.Empty();
+            chunkOrigin = FIntPoint::ZeroValue;
+            chunkExtent = FIntPoint::ZeroValue;
+        }
+
+        int32 num() const
+        {
+            return tiles.Num();
+        }
+
+        /** All tiles in no particular order, the order changes when tiles are removed. */
+        const TArray<TUniquePtr<TileType>>& getTiles() const
+        {
+            return tiles;
+        }
+    };
+}
@@ -0,0 +1,33 @@
+//
+// On-disk store for the cell data of paged out tiles.
+//
+
+#include "TileStore.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
+
+using namespace flow;
+
+TileStore::TileStore(const FString& directory) : directory(directory) {
+}
+
+FString TileStore::getTilePath(const FIntPoint& tileCoordinates) const
+{
+    return FPaths::Combine(directory, FString::Printf(TEXT("%d_%d.tile"), tileCoordinates.X, tileCoordinates.Y));
+}
+
+bool TileStore::save(const FIntPoint& tileCoordinates, const TArray<uint8>& data) const
+{
+    return FFileHelper::SaveArrayToFile(data, *getTilePath(tileCoordinates));
+}
+
+bool TileStore::load(const FIntPoint& tileCoordinates, TArray<uint8>& data) const
+{
+    return FFileHelper::LoadFileToArray(data, *getTilePath(tileCoordinates), FILEREAD_Silent);
+}
+
+void TileStore::clear() const
+{
+    IFileManager::Get().DeleteDirectory(*directory, false, true);
+}
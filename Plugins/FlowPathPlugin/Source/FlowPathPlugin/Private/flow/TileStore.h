@@ -0,0 +1,28 @@
+//
+// On-disk store for the cell data of paged out tiles.
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace flow {
+
+    /** Keeps the cell data of each tile in its own file inside the store directory. */
+    class TileStore {
+    private:
+        FString directory;
+
+        FString getTilePath(const FIntPoint& tileCoordinates) const;
+
+    public:
+        explicit TileStore(const FString& directory);
+
+        bool save(const FIntPoint& tileCoordinates, const TArray<uint8>& data) const;
+
+        bool load(const FIntPoint& tileCoordinates, TArray<uint8>& data) const;
+
+        /** Deletes all stored tiles. */
+        void clear() const;
+    };
+}
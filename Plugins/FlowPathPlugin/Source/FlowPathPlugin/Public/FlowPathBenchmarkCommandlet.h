@@ -0,0 +1,34 @@
+// Created by Michael Galetzka - all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "FlowPathBenchmarkCommandlet.generated.h"
+
+class FJsonValue;
+
+/**
+* Measures the flow:: core on synthetic maps without a world or the editor and writes the results as JSON.
+* Run it with: UE4Editor-Cmd <Project> -run=FlowPathBenchmark -nullrhi [-TileLengths=10,20,50] [-MapTiles=8] [-Samples=200] [-Seed=1] [-Output=<file>]
+*/
+UCLASS()
+class FLOWPATHPLUGIN_API UFlowPathBenchmarkCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+private:
+    int32 sampleCount;
+    int32 mapTiles;
+    int32 seed;
+    TArray<TSharedPtr<FJsonValue>> results;
+
+    void addResult(const TCHAR* benchmark, const TCHAR* mapName, int32 tileLength, TArray<double>& sampleMicros, int32 successCount);
+
+    void runMapBenchmarks(uint8 mapType, int32 tileLength);
+
+public:
+    UFlowPathBenchmarkCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+};
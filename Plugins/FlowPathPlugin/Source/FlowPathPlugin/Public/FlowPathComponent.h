@@ -19,6 +19,17 @@ class FLOWPATHPLUGIN_API UFlowPathComponent : public UActorComponent, public INa
 private:
     FAgentInfo agentInfo;
     FVector2D acceleration;
+    int32 agentHandle = INDEX_NONE;
+    // the sequence number of the last target event read from the agent buffers
+    uint32 acknowledgedEventSequence = 0;
+    // set if a move was issued after the inputs were last written, the target events until then belong to the previous move
+    bool bHasPendingMove = false;
+
+    void registerWithManager();
+
+    void unregisterFromManager();
+
+    void syncAgentBuffers();
 
 public:
 
@@ -48,6 +59,17 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = SteeringComponent)
     uint32 bTickBeforeOwner : 1;
 
+    /**
+    * If true, the component is registered as a native agent and exchanges its data with the manager through the agent buffers.
+    * If false, the manager calls the NavAgent interface of the component every tick.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = SteeringComponent)
+    uint32 bUseAgentBuffers : 1;
+
+    /** If true, the path requests of this agent are handled before the ones of unselected agents. Only used with the agent buffers. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = SteeringComponent)
+    uint32 bIsSelected : 1;
+
     //~ Begin NavAgent Interface 
 
     UFUNCTION(BlueprintNativeEvent, Category = "FlowPath")
@@ -75,6 +97,7 @@ public:
     virtual void Serialize(FArchive& Ar) override;
     virtual void InitializeComponent() override;
     virtual void OnRegister() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
     //~ End ActorComponent Interface
 
     /**
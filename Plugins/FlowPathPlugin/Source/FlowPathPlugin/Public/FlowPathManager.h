@@ -5,17 +5,68 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "flow/FlowPath.h"
+#include "flow/OccupancyGrid.h"
 #include "NavAgent.h"
+#include "FlowPathTrace.h"
+#include "FlowPathRequestLatency.h"
 #include "TransformCalculus2D.h"
 #include "QueuedThreadPool.h"
 #include "IQueuedWork.h"
-#include <list>
 #include "ThreadSafeBool.h"
+#include "Containers/Queue.h"
 #include "FlowPathManager.generated.h"
 
 
+/** The flags of an agent in the agent buffers. */
+namespace AgentFlags {
+    /** Input: the agent tries to reach its target. This flag is cleared by the manager once the target is reached or found to be unreachable. */
+    const uint8 PathfindingActive = 1 << 0;
+
+    /** Output: the last target event of the agent was that it reached its target. The bit stays set until the next event, see AgentBuffers::eventSequences. */
+    const uint8 TargetReached = 1 << 1;
+
+    /** Output: the last target event of the agent was that its target cannot be reached. The bit stays set until the next event, see AgentBuffers::eventSequences. */
+    const uint8 TargetUnreachable = 1 << 2;
+
+    /** Input: the agent is currently not visible to any player, so it can be updated with a lower level of detail. */
+    const uint8 Unseen = 1 << 3;
+
+    /** Input: the agent is selected by a player, so its path requests are handled before the ones of other agents. */
+    const uint8 Selected = 1 << 4;
+}
+
+/** The level of detail an agent is updated with. */
+enum class AgentLOD : uint8 {
+    // updated every tick and steered with flowmaps
+    Full,
+    // steered with flowmaps, but the path is only updated every few ticks
+    Reduced,
+    // steered straight to the next portal without flowmaps, the path is only updated every few ticks
+    Coarse
+};
+
+/**
+* The input and output data of all agents as struct-of-arrays, indexed by the agent handle.
+* The positions, targets, flags and groups are read by the manager once per tick, the accelerations and output flags are written once per tick.
+*/
+struct AgentBuffers {
+    TArray<FVector2D> positions;
+    TArray<FVector2D> targets;
+    TArray<uint8> flags;
+    TArray<int32> groups;
+    TArray<FVector2D> accelerations;
+    // incremented for each published target event, so a reader that skipped ticks can still tell a new event from one it already handled
+    TArray<uint32> eventSequences;
+
+    void setNum(int32 num);
+
+    void reset(int32 handle);
+};
+
 struct AgentData {
-    UObject* agent;
+    // the interface object of the agent, or null if the agent only uses the agent buffers
+    UObject* agent = nullptr;
+    int32 handle;
 
     // data from the current tick
     FAgentInfo current;
@@ -31,28 +82,124 @@ struct AgentData {
     bool isPathDataDirty = false;
     FVector2D targetAcceleration;
     TArray<const flow::Portal*> waypoints;
-    int32 waypointIndex;
+    int32 waypointIndex = 0;
+    // the target the waypoints were searched for
+    flow::TilePoint waypointTarget;
+
+    // results of the parallel update, they are committed on the game thread
+    bool hasReachedTarget = false;
+    bool isSteady = false;
+    // stays set until the portal search is done, as a deferred search must survive the following ticks
+    bool needsPortalSearch = false;
+    int32 lookupIndex = -1;
+    // set if the next portal window is in line of sight, the agent can then steer there while its flowmap is created
+    bool hasPortalFallbackDirection = false;
+    FVector2D portalFallbackDirection;
+    // set if the target is in line of sight, the agent can then steer straight there while its flowmap is created
+    bool hasTargetFallbackDirection = false;
+
+    // the estimated speed in cells per second, used to predict when the agent needs a flowmap
+    float cellSpeed = 0;
+
+    AgentLOD lod = AgentLOD::Full;
+
+    // the time at which the agent started waiting for a path update, or a negative value if it is not waiting
+    double pathRequestTime = -1;
+
+    // the lifecycle of the current move order, the request time is negative if no move order is pending
+    double moveRequestTime = -1;
+    double firstMoveTime = -1;
+    bool isMoveRequestCacheMiss = false;
 };
 
-class FlowMapGenerationTask : public IQueuedWork
+/** Identifies a flowmap task, either by the portals of a portal flowmap or by the target cell of a target flowmap. */
+struct FlowMapTaskKey {
+    // null portals for a target flowmap
+    flow::FlowPortalKey portals;
+    // only used by target flowmaps
+    flow::TilePoint target;
+
+    bool isTargetMap() const
+    {
+        return portals.targetPortal == nullptr;
+    }
+
+    bool operator==(const FlowMapTaskKey& Other) const
+    {
+        return portals == Other.portals && target == Other.target;
+    }
+
+    friend uint32 GetTypeHash(const FlowMapTaskKey& Other)
+    {
+        return HashCombine(GetTypeHash(Other.portals), HashCombine(GetTypeHash(Other.target.tileLocation), GetTypeHash(Other.target.pointInTile)));
+    }
+};
+
+/** The base of the tasks of the manager, a finished task is handed back to the game thread through its completion queue. */
+template<typename TaskType>
+class FlowPathQueuedWork : public IQueuedWork
 {
 private:
-    flow::TilePoint target;
-    TArray<const flow::Portal*> waypoints;
-    int32 workIndex;
-    bool lookaheadAllowed;
+    TQueue<TaskType*, EQueueMode::Mpsc>& completionQueue;
+
+protected:
+    explicit FlowPathQueuedWork(TQueue<TaskType*, EQueueMode::Mpsc>& completionQueue)
+        : completionQueue(completionQueue)
+    {
+    }
+
+    /** Hands the finished task to the game thread. This has to be the last access to the task, as the game thread can delete it as soon as it is in the queue. */
+    void complete()
+    {
+        completionQueue.Enqueue(static_cast<TaskType*>(this));
+    }
+
+public:
+    /** The pool is only destroyed together with the tasks, so there is nothing to clean up. */
+    void Abandon() override
+    {
+    }
+};
+
+class FlowMapGenerationTask;
+
+/** Worker threads push their finished tasks into this queue, the game thread is the only consumer. */
+typedef TQueue<FlowMapGenerationTask*, EQueueMode::Mpsc> FlowMapCompletionQueue;
+
+class FlowMapGenerationTask : public FlowPathQueuedWork<FlowMapGenerationTask>
+{
+private:
+    const flow::Portal* nextPortal;
+    const flow::Portal* endPortal;
+    bool usesLookahead;
     flow::FlowPath& flowPath;
     FCriticalSection& tileLock;
 
 public:
+    FlowMapTaskKey key;
     FIntPoint workingTile;
-    FThreadSafeBool isDone;
+    TArray<FIntPoint, TInlineAllocator<4>> sourceTiles;
+    int32 requestCount;
+    float priority;
+    bool isDispatched;
+    // when the task was queued, used for the latency histogram
+    double queuedTime = 0;
     FThreadSafeBool isAbandoned;
     TArray<flow::EikonalCellValue> result;
-    const flow::Portal * resultStartPortal;
-    const flow::Portal * resultEndPortal;
 
-    FlowMapGenerationTask(const flow::TilePoint& target, TArray<const flow::Portal*> waypoints, int32 workIndex, bool lookahead, flow::FlowPath& flowPath, FCriticalSection& tileLock);
+    FlowMapGenerationTask(const flow::Portal* nextPortal, const flow::Portal* connectedPortal, const flow::Portal* lookaheadPortal, flow::FlowPath& flowPath, FCriticalSection& tileLock, FlowMapCompletionQueue& completionQueue);
+
+    /** Creates the task for the flowmap inside the target tile that leads to the target cell. */
+    FlowMapGenerationTask(const flow::TilePoint& target, flow::FlowPath& flowPath, FCriticalSection& tileLock, FlowMapCompletionQueue& completionQueue);
+
+    /** Returns the key of the flowmap that is created for the given portals. Identical keys always result in the same flowmap. */
+    static FlowMapTaskKey createKey(const flow::Portal* nextPortal, const flow::Portal* connectedPortal, const flow::Portal* lookaheadPortal);
+
+    /** Returns the key of the flowmap that leads to the given target inside its tile. */
+    static FlowMapTaskKey createTargetKey(const flow::TilePoint& target);
+
+    /** Returns true if the portals or cell data of one of the given tiles are read by this task. */
+    bool isUsingTile(const TSet<FIntPoint>& tiles) const;
     
     /**
     * Tells the queued work that it is being abandoned so that it can do
@@ -69,6 +216,59 @@ public:
     void DoThreadedWork() override;
 };
 
+class TileBuildTask;
+
+/** Worker threads push their finished tile builds into this queue, the game thread is the only consumer. */
+typedef TQueue<TileBuildTask*, EQueueMode::Mpsc> TileBuildCompletionQueue;
+
+/** Constructs a tile from a copy of its data on a worker thread, the game thread publishes it once it is done. */
+class TileBuildTask : public FlowPathQueuedWork<TileBuildTask>
+{
+private:
+    flow::FlowPath& flowPath;
+
+public:
+    FIntPoint tileCoordinates;
+    TArray<uint8> tileData;
+    // the tile update this task belongs to, the task is outdated if the tile was updated again afterwards
+    uint32 version;
+    TUniquePtr<flow::FlowTile> result;
+
+    TileBuildTask(const FIntPoint& tileCoordinates, const TArray<uint8>& tileData, uint32 version, flow::FlowPath& flowPath, TileBuildCompletionQueue& completionQueue);
+
+    void DoThreadedWork() override;
+};
+
+class TilePagingTask;
+
+/** Worker threads push their finished paging batches into this queue, the game thread is the only consumer. */
+typedef TQueue<TilePagingTask*, EQueueMode::Mpsc> TilePagingCompletionQueue;
+
+/** Loads the prefetched tiles and saves the paged out tiles on a worker thread, the game thread applies the batch once it is done. */
+class TilePagingTask : public FlowPathQueuedWork<TilePagingTask>
+{
+private:
+    flow::FlowPath& flowPath;
+
+public:
+    flow::TilePagingBatch batch;
+
+    TilePagingTask(flow::TilePagingBatch&& batch, flow::FlowPath& flowPath, TilePagingCompletionQueue& completionQueue);
+
+    void DoThreadedWork() override;
+};
+
+/** Orders the flowmap tasks by the estimated time until an agent needs the flowmap. */
+struct FlowMapTaskPriority
+{
+    bool operator()(const FlowMapGenerationTask& A, const FlowMapGenerationTask& B) const
+    {
+        return A.priority < B.priority;
+    }
+};
+
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FFlowTileUpdatedDelegate, int32, TileX, int32, TileY, bool, Success);
 
 UCLASS(meta = (BlueprintSpawnableComponent), BlueprintType)
 class FLOWPATHPLUGIN_API AFlowPathManager : public AActor
@@ -76,25 +276,177 @@ class FLOWPATHPLUGIN_API AFlowPathManager : public AActor
     GENERATED_BODY()
 private:
     TUniquePtr<flow::FlowPath> flowPath;
-    TMap<UObject*, AgentData> agents;
+    TSparseArray<AgentData> agents;
+    TMap<UObject*, int32> agentIndices;
+    AgentBuffers agentBuffers;
     FTransform2D WorldToTileTransform;
     int32 ticksSinceLastCleanup;
+    int32 ticksSinceCacheSizeSample = 0;
+    int32 ticksSincePriorityRescan = 0;
+    // the latency of the move orders of this manager, the totals of all managers are in the counters
+    flow::MoveRequestLatency requestLatency;
+    // the start of the current tick, new move orders are timestamped with it
+    double tickStartTime = 0;
     
-    TSet<FIntPoint> blockedCells;
-    TMap<FIntPoint, UObject*> reservedCells;
-
+    TUniquePtr<flow::OccupancyGrid> occupancy;
+
+    // the positions of the player views, used to calculate the agent LOD
+    TArray<FVector2D> lodViewers;
+    uint32 lodTickCounter = 0;
+
+    // the task containers are declared before the pool, so the pool threads are stopped before the tasks are destroyed
+    TMap<FlowMapTaskKey, TUniquePtr<FlowMapGenerationTask>> generatorTasks;
+    TArray<TUniquePtr<FlowMapGenerationTask>> abandonedTasks;
+    TArray<FlowMapGenerationTask*> pendingTasks;
+    TArray<FlowMapGenerationTask*> dispatchedTasks;
+    FlowMapCompletionQueue completionQueue;
+    TArray<TUniquePtr<TileBuildTask>> tileBuildTasks;
+    TileBuildCompletionQueue tileBuildQueue;
+    TArray<TUniquePtr<TilePagingTask>> tilePagingTasks;
+    TilePagingCompletionQueue tilePagingQueue;
+    // counts the updates of each tile, so the result of an outdated tile build is dropped
+    TMap<FIntPoint, uint32> tileVersions;
     TUniquePtr<FQueuedThreadPool> Pool;
-    std::list<FlowMapGenerationTask> generatorTasks;
-    FCriticalSection tileLock;
+    int32 poolThreadCount;
+    // locked by the const queries that have to page in tiles as well
+    mutable FCriticalSection tileLock;
+
+    // the changes of the open map update are staged and applied together when the update is committed,
+    // so the tile lock is only held while they are applied and never while a script keeps the update open
+    int32 mapUpdateDepth = 0;
+    TArray<TFunction<bool()>> stagedMapUpdates;
+    // the evicted flowmap count when the open map update began
+    int64 mapUpdateEvictionStart = 0;
+    TSet<FIntPoint> pendingChangedTiles;
+    TSet<FIntPoint> pendingConnectionTiles;
+    TSet<const flow::Portal*> pendingRemovedPortals;
+
+    // the inputs are recorded while the writer exists, calls the manager makes to itself are not recorded
+    TUniquePtr<FlowPathTraceWriter> traceWriter;
+    bool isTraceSuspended = false;
+    // replayed agents are native agents, the recorded handles are mapped to the new ones
+    bool isReplaying = false;
+    TMap<int32, int32> replayHandles;
+    TArray<FVector2D> replayLODViewers;
     
+    void parallelForAgents(TFunctionRef<void(AgentData&)> callback);
+
+    void updateAgentState(AgentData& data, float DeltaTime);
+
+    void updateResidentTiles();
+
+    /** Applies the paging batches the worker threads have finished. */
+    void processTilePaging();
+
+    /** Reads and writes the files of the batch on the calling thread without holding the lock and applies the batch afterwards. */
+    void transferTilesNow(flow::TilePagingBatch& batch) const;
+
+    /** Pages in the given tiles right away, so their cell data can be searched. */
+    void loadTilesNow(const TSet<FIntPoint>& tiles) const;
+
+    /** Stops the generator pool, drops all tasks and their results and updates the world to tile transform. The flow path is left to the caller. */
+    void resetTasks();
+
+    void configureFlowPath();
+
+    FString getTileStoreDirectory() const;
+
+    FString getNavDataPath(const FString& filename) const;
+
+    void gatherLODViewers();
+
+    AgentLOD calculateLOD(const AgentData& data) const;
+
+    bool isLODUpdateTick(const AgentData& data) const;
+
+    bool updateCoarseSteering(AgentData& data);
+
+    void publishAcceleration(AgentData& data);
+
+    /** Adds the latency samples of the pending move order once the agent follows its path. */
+    void completeMoveRequest(AgentData& data);
+
+    void publishTargetReached(AgentData& data);
+
+    void publishTargetUnreachable(AgentData& data);
+
     void updateDirtyPathData();
 
+    void processPathRequests(TArray<AgentData*>& requests);
+
+    float getPathRequestPriority(const AgentData& data, double now) const;
+
+    void updateAgentWaypoints(AgentData& data);
+
+    int32 lookupFlowMapDirection(const AgentData& data, bool allowCreation);
+
+    void commitAgentPath(AgentData& data);
+
     void processFlowMapGenerators();
 
+    /** Returns false if the flowmap is neither cached nor queued, because the task queue is full. */
+    bool requestFlowMap(const flow::Portal* nextPortal, const flow::Portal* connectedPortal, const flow::Portal* lookaheadPortal, float arrivalTime);
+
+    bool subscribeFlowMapTask(const FlowMapTaskKey& key, float arrivalTime);
+
+    /** Returns the index of the least urgent pending task that is less urgent than the arrival time, or INDEX_NONE. */
+    int32 findEvictableFlowMapTask(float arrivalTime) const;
+
+    bool hasFlowMapTaskSlot(float arrivalTime) const;
+
+    /** Makes room for a new task if the queue is full, a request for a waiting agent evicts the least urgent pending task. */
+    bool reserveFlowMapTaskSlot(float arrivalTime);
+
+    void addFlowMapTask(FlowMapGenerationTask* task, float arrivalTime);
+
+    /**
+    * Updates the priorities of the queued flowmap tasks from the next few flowmaps of every agent. The whole routes are only rescanned every few ticks,
+    * which also removes the tasks no agent needs anymore.
+    */
+    void updateFlowMapPriorities();
+
+    void dispatchFlowMapTasks();
+
+    bool preemptSpeculativeTask();
+
+    void abandonFlowMapTasks(const TSet<FIntPoint>& tileCoordinates);
+
+    flow::TilePoint getReservationTarget(const AgentData& data) const;
+
+    void invalidateUpdatedTile(const FIntPoint& tileCoord, flow::CellUpdateResult result, const TArray<const flow::Portal*>& originalTilePortals);
+
+    void applyMapInvalidation();
+
+    bool updateMapTiles(const TArray<FIntPoint>& tileCoordinates, const TArray<TArray<uint8>>& tilesData);
+
+    uint32 incrementTileVersion(const FIntPoint& tileCoord);
+
+    void processTileBuilds();
+
+    void commitOpenMapUpdates();
+
+    /** Stages the change for the open map update, or applies it right away if no update is open. Returns false if it was applied and failed. */
+    bool stageMapUpdate(TFunction<bool()>&& update);
+
+    /** Applies the staged changes while holding the tile lock. Returns false if one of them failed. */
+    bool applyStagedMapUpdates();
+
     void normalizeTilePoint(flow::TilePoint& p) const;
 
+    bool isRecordingInput() const;
+
+    TArray<TPair<FString, FString>> getTraceConfig() const;
+
+    void applyTraceConfig(const TArray<TPair<FString, FString>>& config);
+
+    void recordSnapshot();
+
+    void recordTick(float DeltaTime);
+
 protected:
 
+    virtual void BeginPlay() override;
+
     FIntPoint toAbsoluteTileLocation(flow::TilePoint p) const;
 
     FVector2D toAbsoluteTileLocationFloat(flow::TilePoint p) const;
@@ -109,10 +461,36 @@ protected:
 
     bool findClosestWaypoint(const AgentData& data, const flow::TilePoint& agentLocation, flow::TilePoint& result) const;
 
+    const flow::Portal* getLookaheadPortal(const AgentData& data, int32 waypointIndex) const;
+
+    /** Calls the callback with the index and estimated arrival time of the next waypoints and returns the arrival time at the last visited one. */
+    float forEachWaypointArrival(const AgentData& data, TFunctionRef<void(int32, float)> callback, int32 waypointCount = MAX_int32) const;
+
+    /** Calls the callback for the flowmaps of the tiles the agent enters next, at most one for every two of the given waypoints. */
+    void forEachUpcomingFlowMap(const AgentData& data, TFunctionRef<void(const flow::Portal*, const flow::Portal*, const flow::Portal*, float)> callback, int32 waypointCount = MAX_int32) const;
+
+    float estimateTargetArrivalTime(const AgentData& data) const;
+
     void precomputeFlowmaps(const AgentData& data);
 
+    bool requestTargetFlowMap(const flow::TilePoint& target, float arrivalTime);
+
+    bool isTargetFlowMapQueued(const flow::TilePoint& target) const;
+
+    bool isWaitingForTargetFlowMap(const AgentData& data) const;
+
+    /** Steers straight to a visible target while the pool creates its flowmap. Returns false if the target is not visible or the request could not be queued. */
+    bool updateTargetFallbackSteering(AgentData& data);
+
+    bool canUsePortalFallbackSteering(const AgentData& data) const;
+
+    bool updatePortalFallbackSteering(AgentData& data);
+
     void cleanupOldFlowmaps();
 
+    /** Updates the cache size counters and stats, which have to walk all tiles and are therefore only sampled every few ticks. */
+    void sampleCacheSizes();
+
 public:	
 
     /** The cell value of a blocked tile. No movement is allowed through a blocked cell. */
@@ -173,6 +551,103 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = FlowPath, meta = (ClampMin = "0", ClampMax = "1"))
     float BlockedMovementSpeedFactor;
 
+    /**
+    * If true then agents far away from all players or not visible are updated with a lower level of detail.
+    * Agents in the tile of their target are always updated with full detail.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = FlowPath)
+    bool AgentLODEnabled;
+
+    /** Agents within this world distance to a player view are always updated with full detail. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = FlowPath, meta = (EditCondition = "AgentLODEnabled", ClampMin = "0"))
+    float FullLODDistance;
+
+    /** Visible agents within this world distance to a player view are updated with reduced detail, all others are steered coarsely. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = FlowPath, meta = (EditCondition = "AgentLODEnabled", ClampMin = "0"))
+    float ReducedLODDistance;
+
+    /** The path of an agent with reduced detail is only updated every this many ticks. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = FlowPath, meta = (EditCondition = "AgentLODEnabled", ClampMin = "1"))
+    int32 ReducedLODTickInterval;
+
+    /** The path of a coarsely steered agent is only updated every this many ticks. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = FlowPath, meta = (EditCondition = "AgentLODEnabled", ClampMin = "1"))
+    int32 CoarseLODTickInterval;
+
+    /**
+    * If true then only the cell data and flowmaps of the tiles around the agents, their targets and upcoming waypoints are kept in memory.
+    * The data of the other tiles is paged out to the tile store directory, the portals of all tiles stay resident so long paths can still be searched.
+    * Takes effect when the tiles are initialized.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath)
+    bool TilePagingEnabled;
+
+    /** The number of tiles whose data is kept in memory while paging. Tiles that are used by agents are never paged out, even if there are more. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath, meta = (EditCondition = "TilePagingEnabled", ClampMin = "1"))
+    int32 MaxResidentTiles;
+
+    /** The directory the paged out tiles are written to. If empty, a directory in the saved folder of the project is used. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath, meta = (EditCondition = "TilePagingEnabled"))
+    FString TileStoreDirectory;
+
+    /**
+    * The file with the baked navigation data that is loaded when the game starts, so the tiles and portals do not have to be built at level load.
+    * Relative paths are relative to the project directory. The data has to be baked with the same tile length.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath)
+    FString BakedNavDataFile;
+
+    /** If true then the cached flowmaps are baked together with the tiles. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath)
+    bool BakeFlowMaps;
+
+    /**
+    * The file of the persistent flowmap cache. Solved flowmaps are stored by a hash of their cost data and targets and reused in later sessions.
+    * Relative paths are relative to the saved directory of the project. If empty, flowmaps are only cached in memory. Takes effect when the tiles are initialized.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath)
+    FString FlowMapDiskCacheFile;
+
+    /** No more flowmaps are added to the persistent cache once its file has reached this size. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath, meta = (ClampMin = "1"))
+    int32 MaxFlowMapDiskCacheSizeMB;
+
+    /**
+    * The buffers of removed flowmaps are kept up to this size and reused by the next solves, so editing the map does not churn the heap.
+    * The pool is shared by all managers. Takes effect when the tiles are initialized.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath, meta = (ClampMin = "0"))
+    int32 MaxFlowMapPoolSizeMB;
+
+    /**
+    * If true then the agents are updated in parallel on the task graph. Only the path searches, the flowmap creation and
+    * the calls to the agents are done on the game thread.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath)
+    bool ParallelAgentUpdate;
+
+    /**
+    * If true then a missing flowmap is never created on the game thread if an agent can see the next portal.
+    * The agent steers straight to the portal window until the flowmap is created by the thread pool.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath)
+    bool NonBlockingFlowMapLookup;
+
+    /**
+    * The time in microseconds that can be spent per tick on path searches and flowmaps that are created on the game thread.
+    * Requests that do not fit into the budget are carried over to the next tick, the waiting agents keep their last acceleration.
+    * At least one request is handled per tick. A value <= 0 disables the budget.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath)
+    float PathRequestBudgetMicroseconds;
+
+    /**
+    * The path requests of selected agents are handled as if they had already waited this many seconds longer.
+    * Requests of other agents are still handled once they have waited long enough, so no request starves.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath, meta = (ClampMin = "0"))
+    float SelectedPathRequestBonus;
+
     /**
     * The number of thread that should be used to generate flowmaps. A number <= 0 disables threaded flowmap generation.
     */
@@ -185,6 +660,20 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath)
     int32 MaxAsyncFlowMapUpdatesPerTick;
 
+    /**
+    * The max number of flowmap tasks that can be queued at the same time. Requests for the same flowmap are merged into a single task,
+    * additional requests beyond this limit are dropped and the flowmap is created when an agent actually needs it.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath)
+    int32 MaxQueuedFlowMapTasks;
+
+    /**
+    * Flowmaps are generated in the order in which the agents are expected to need them.
+    * A flowmap that is needed within this many seconds is urgent and preempts queued flowmaps that are needed later.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, AdvancedDisplay, Category = FlowPath, meta = (ClampMin = "0"))
+    float UrgentFlowMapTime;
+
     /**
     * The number of ticks that need to pass before all cached and unused flowmaps are deleted to reclaim memory.
     * A negative value means flowmaps will never be deleted once created (as long as the source data is not changed).
@@ -200,21 +689,71 @@ public:
     UFUNCTION(BlueprintCallable, Category = "FlowPath")
     void InitializeTiles();
 
+    /**
+    * Starts a map update. All tile and cell updates until the matching CommitMapUpdate are staged and applied as one batch:
+    * the rebuilt tiles are connected once and the agents and flowmap tasks are invalidated in a single pass.
+    * While the update is open the updates only check their data and return false if it is invalid, the map does not change until the commit.
+    * Updates can be nested, the batch is applied by the outermost commit. An update that is still open when the manager ticks is committed.
+    */
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    void BeginMapUpdate();
+
+    /** Applies all tile and cell updates since the matching BeginMapUpdate. */
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    void CommitMapUpdate();
+
     /** Updates the specified tile with the given data. The data must *not* contain 0 values. The given world vector is transformed and truncated into tile coordinates.*/
     UFUNCTION(BlueprintCallable, Category = "FlowPath")
     bool UpdateMapTileWorld(FVector2D worldPosition, const TArray<uint8> &tileData);
 
-    /** Updates the specified tile with the given data. The data must *not* contain 0 values. */
+    /**
+    * Updates the specified tile with the given data. The data must *not* contain 0 values.
+    * If the portal windows at the tile border stay the same, the portals keep their identity and the routes of the agents stay valid.
+    */
     UFUNCTION(BlueprintCallable, Category = "FlowPath")
     bool UpdateMapTileLocal(int32 tileX, int32 tileY, const TArray<uint8> &tileData);
 
+    /**
+    * Updates a rectangular region of cells, given in absolute cell coordinates, with row-major data. The data must *not* contain 0 values.
+    * Changes inside a tile keep its portals and only invalidate the flowmaps that covered the changed cells, a tile is only rebuilt if its portals change.
+    */
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    bool UpdateMapCells(FIntPoint cellOrigin, FIntPoint regionSize, const TArray<uint8>& cellData);
+
+    /**
+    * Same as UpdateMapTileLocal, but the tile is constructed on the generator thread pool from a copy of the data.
+    * The game thread only connects the finished tile with its neighbors and invalidates the old one, OnTileUpdated is called once the tile is live.
+    * The tile is always recreated, so use UpdateMapCells for small changes. Any update of the same tile that is started later replaces this one,
+    * in that case OnTileUpdated is called without success.
+    * Returns false if the data is invalid. Without generator threads the tile is updated immediately.
+    */
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    bool UpdateMapTileAsync(int32 tileX, int32 tileY, const TArray<uint8> &tileData);
+
+    /** Called when a tile that was updated with UpdateMapTileAsync is live. */
+    UPROPERTY(BlueprintAssignable, Category = "FlowPath")
+    FFlowTileUpdatedDelegate OnTileUpdated;
+
     /** Updates the tiles with the pixel data from the texture. Each pixel of the texture is converted to a byte value for the tile data. If the texture is not a multiple of the tilesize, the additional cells are marked as blocked. */
     UFUNCTION(BlueprintCallable, Category = "FlowPath")
     bool UpdateMapTilesFromTexture(int32 tileXUpperLeft, int32 tileYUpperLeft, UTexture2D* texture);
 
+    /** Returns the data of the cell at the world position. The cells of tiles that are paged out are reported as blocked. */
     UFUNCTION(BlueprintCallable, Category = "FlowPath")
     uint8 GetTileDataForWorldPosition(FVector2D worldPosition);
 
+    /** Writes the current tiles, portals and portal connections, and optionally the cached flowmaps, into a versioned binary file. */
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    bool SaveBakedNavData(const FString& filename, bool includeFlowMaps);
+
+    /** Replaces all tiles with the baked navigation data from the file. The agents search their paths again. */
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    bool LoadBakedNavData(const FString& filename);
+
+    /** Bakes the current navigation data into the baked nav data file. */
+    UFUNCTION(CallInEditor, Category = "FlowPath")
+    void BakeNavData();
+
     /** Registers an agent with this path manager, so it can be steered together with other agents. */
     UFUNCTION(BlueprintCallable, Category = "FlowPath")
     void RegisterAgent(UObject* agent);
@@ -223,6 +762,47 @@ public:
     UFUNCTION(BlueprintCallable, Category = "FlowPath")
     void RemoveAgent(UObject* agent);
 
+    /**
+    * Creates a native agent that is steered through the agent buffers instead of the INavAgent interface.
+    * The returned handle is the index of the agent in the agent buffers.
+    */
+    int32 CreateAgentHandle();
+
+    /** Removes a native agent from the path manager. The handle can be reused by the next created agent. */
+    void ReleaseAgentHandle(int32 handle);
+
+    /** Returns true if the handle belongs to an agent of this manager, either a native one or one that implements the agent interface. */
+    bool IsValidAgentHandle(int32 handle) const;
+
+    /** The buffers of all agents. The inputs have to be written before the manager ticks, the outputs are valid after the manager has ticked. */
+    AgentBuffers& GetAgentBuffers();
+
+    /**
+    * Starts recording the inputs of the manager into a binary trace: the config, the map, the agents, their inputs of every tick and all map updates.
+    * The trace can be replayed headless with the FlowPathReplay commandlet. Relative filenames are relative to the saved directory of the project.
+    */
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    bool StartRecording(const FString& filename);
+
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    void StopRecording();
+
+    /**
+    * Applies a recorded event. The recorded agents are replayed as native agents. A tick event only writes the agent inputs,
+    * the manager has to be ticked with the recorded delta time afterwards. Returns false if the event could not be applied.
+    */
+    bool ReplayTraceEvent(const FlowPathTraceEvent& event, const FlowPathTraceReader& reader);
+
+    /**
+    * Returns the latency of the agent move orders since the last reset, split by whether the caches could serve the request.
+    * Only the agents of this manager are counted. The FlowPath.RequestLatency console command writes the totals of all managers to the log.
+    */
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    FFlowPathRequestLatency GetRequestLatency() const;
+
+    UFUNCTION(BlueprintCallable, Category = "FlowPath")
+    void ResetRequestLatency();
+
     /** Checks if an agent can travel from the given start to the given end. */
     UFUNCTION(BlueprintCallable, Category = "FlowPath")
     bool IsPathPossible(FVector2D worldPositionStart, FVector2D worldPositionEnd) const;
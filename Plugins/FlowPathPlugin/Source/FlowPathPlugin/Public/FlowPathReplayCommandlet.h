@@ -0,0 +1,24 @@
+// Created by Michael Galetzka - all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "FlowPathReplayCommandlet.generated.h"
+
+/**
+* Replays a trace recorded with AFlowPathManager::StartRecording in a headless world and reports the tick times, cache hit rates and flowmap job counts as JSON.
+* Run it with: UE4Editor-Cmd <Project> -run=FlowPathReplay -nullrhi -Trace=<file> [-Output=<file>] [-Deterministic] [-ChromeTrace=<file>]
+* With -Deterministic the flowmaps are created on the game thread, the agents are updated sequentially and the path request budget is disabled,
+* so two replays of the same trace do the same work. With -ChromeTrace the game thread and worker spans are written as Chrome trace event JSON.
+*/
+UCLASS()
+class FLOWPATHPLUGIN_API UFlowPathReplayCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UFlowPathReplayCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+};
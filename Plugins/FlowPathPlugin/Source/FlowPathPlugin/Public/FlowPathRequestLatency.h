@@ -0,0 +1,66 @@
+// Created by Michael Galetzka - all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowPathRequestLatency.generated.h"
+
+/** The distribution of a latency in milliseconds. The percentiles are within 12.5% of the exact value. */
+USTRUCT(BlueprintType)
+struct FFlowPathLatencyPercentiles
+{
+    GENERATED_USTRUCT_BODY()
+
+    /** The number of samples. */
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        int32 Count = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        float MeanMs = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        float P50Ms = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        float P95Ms = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        float P99Ms = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        float MaxMs = 0;
+};
+
+/**
+* The latency of the agent move orders, measured from the tick in which the manager sees a new target until the agent moves.
+* A request counts as a cache hit if neither its portal search nor its flowmap had to be computed and it never had to wait for the flowmap or retry.
+*/
+USTRUCT(BlueprintType)
+struct FFlowPathRequestLatency
+{
+    GENERATED_USTRUCT_BODY()
+
+    /** The number of move orders since the last reset, including the ones that were cancelled or are still waiting. */
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        int32 Requests = 0;
+
+    /** The number of times a flowmap lookup failed and the path of a waiting agent was searched again. */
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        int32 Retries = 0;
+
+    /** Until the agent follows its flowmap, for the requests that were served from the caches. */
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        FFlowPathLatencyPercentiles PathReadyCacheHit;
+
+    /** Until the agent follows its flowmap, for the requests that had to compute their path or flowmap. */
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        FFlowPathLatencyPercentiles PathReadyCacheMiss;
+
+    /** Until the agent receives its first acceleration, which can also come from the fallback steering, for the requests that were served from the caches. */
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        FFlowPathLatencyPercentiles FirstMoveCacheHit;
+
+    /** Until the agent receives its first acceleration, which can also come from the fallback steering, for the requests that had to compute their path or flowmap. */
+    UPROPERTY(BlueprintReadOnly, Category = "FlowPath")
+        FFlowPathLatencyPercentiles FirstMoveCacheMiss;
+};
@@ -0,0 +1,114 @@
+// Created by Michael Galetzka - all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** The recorded inputs of the flow path manager. */
+enum class FlowPathTraceEventType : uint8 {
+    // the editable properties of the manager, written when recording starts and whenever they change
+    Config,
+    // the tiles are recreated and filled with the recorded data
+    Snapshot,
+    InitializeTiles,
+    AgentCreated,
+    AgentReleased,
+    // the delta time, the LOD viewers and the agent inputs that changed since the last tick
+    Tick,
+    BeginMapUpdate,
+    CommitMapUpdate,
+    TileUpdate,
+    TileUpdateAsync,
+    CellUpdate,
+    TilesUpdate
+};
+
+/** The inputs of an agent as read from the agent buffers. */
+struct FlowPathTraceAgentInput {
+    FVector2D position = FVector2D::ZeroVector;
+    FVector2D target = FVector2D::ZeroVector;
+    uint8 flags = 0;
+    int32 group = -1;
+
+    bool operator==(const FlowPathTraceAgentInput& other) const
+    {
+        return position == other.position && target == other.target && flags == other.flags && group == other.group;
+    }
+
+    friend FArchive& operator<<(FArchive& ar, FlowPathTraceAgentInput& input)
+    {
+        return ar << input.position << input.target << input.flags << input.group;
+    }
+};
+
+/** One recorded event, only the fields used by its type are set. */
+struct FlowPathTraceEvent {
+    FlowPathTraceEventType type = FlowPathTraceEventType::Tick;
+    // the recorded agent handle
+    int32 handle = INDEX_NONE;
+    float deltaTime = 0;
+    TArray<FVector2D> lodViewers;
+    // the cell region of a cell update
+    FIntPoint origin = FIntPoint::ZeroValue;
+    FIntPoint size = FIntPoint::ZeroValue;
+    TArray<FIntPoint> tileCoordinates;
+    TArray<TArray<uint8>> tilesData;
+    TArray<TPair<FString, FString>> config;
+};
+
+/**
+* Writes the inputs of a manager into a compact binary trace. Agent inputs are only written if they changed since the last tick,
+* so idle agents cost nothing.
+*/
+class FlowPathTraceWriter {
+private:
+    TUniquePtr<FArchive> file;
+    TMap<int32, FlowPathTraceAgentInput> lastInputs;
+    TArray<TPair<FString, FString>> lastConfig;
+
+    void beginEvent(FlowPathTraceEventType type);
+
+public:
+    ~FlowPathTraceWriter();
+
+    bool open(const FString& filename);
+
+    void close();
+
+    bool isOpen() const;
+
+    /** Only writes the config if it differs from the last written one. */
+    void writeConfig(const TArray<TPair<FString, FString>>& config);
+
+    void writeSnapshot(const TArray<FIntPoint>& tileCoordinates, const TArray<TArray<uint8>>& tilesData);
+
+    void writeEvent(FlowPathTraceEventType type);
+
+    void writeAgentEvent(FlowPathTraceEventType type, int32 handle);
+
+    void writeTick(float deltaTime, const TArray<FVector2D>& lodViewers, const TArray<TPair<int32, FlowPathTraceAgentInput>>& inputs);
+
+    void writeTileUpdate(FlowPathTraceEventType type, const FIntPoint& tileCoordinates, const TArray<uint8>& tileData);
+
+    void writeCellUpdate(const FIntPoint& origin, const FIntPoint& size, const TArray<uint8>& cellData);
+
+    void writeTilesUpdate(const TArray<FIntPoint>& tileCoordinates, const TArray<TArray<uint8>>& tilesData);
+};
+
+/** Reads a trace written by FlowPathTraceWriter and keeps the current inputs of all recorded agents. */
+class FlowPathTraceReader {
+private:
+    TUniquePtr<FArchive> file;
+    TMap<int32, FlowPathTraceAgentInput> inputs;
+
+public:
+    bool open(const FString& filename);
+
+    /** Reads the next event. Returns false at the end of the trace or if the trace is invalid. */
+    bool readEvent(FlowPathTraceEvent& event);
+
+    bool isError() const;
+
+    /** The inputs of all agents that exist after the last read event, by their recorded handle. */
+    const TMap<int32, FlowPathTraceAgentInput>& getAgentInputs() const;
+};